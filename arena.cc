@@ -0,0 +1,78 @@
+// bump allocator over huge-page-backed chunks
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "arena.h"
+
+using namespace std;
+
+arena::arena (void) {
+	chunks = NULL;
+	next = end = NULL;
+	memset (&usage, 0, sizeof (usage));
+}
+
+// map a chunk with room for n more bytes, starting on a huge page
+// boundary if it is at least a huge page
+
+void arena::new_chunk (size_t n) {
+	// arenas are made on any simulator's thread, so read this just once
+	static once_flag once;
+	static int hugepages;
+	call_once (once, [] () {
+		char *s = getenv ("DAN_HUGEPAGES");
+		hugepages = s ? atoi (s) : 1;
+	});
+	size_t size = ARENA_MIN_CHUNK << (usage.chunks < 8 ? usage.chunks : 8);
+	if (size > ARENA_CHUNK) size = ARENA_CHUNK;
+	n += ARENA_ALIGN;	// the chunk's header
+	if (n > size) size = n;
+	size_t align = size >= ARENA_HUGEPAGE ? ARENA_HUGEPAGE : (size_t) sysconf (_SC_PAGESIZE);
+	size = (size + align - 1) & ~(align - 1);
+
+	// over-reserve by the alignment and trim so the chunk starts aligned
+
+	char *p = (char *) mmap (NULL, size + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (p == MAP_FAILED) {
+		perror ("arena mmap");
+		exit (1);
+	}
+	char *start = (char *) (((unsigned long long int) p + align - 1) & ~(unsigned long long int) (align - 1));
+	if (start > p) munmap (p, start - p);
+	munmap (start + size, p + align - start);
+#ifdef MADV_HUGEPAGE
+	if (hugepages && align == ARENA_HUGEPAGE) madvise (start, size, MADV_HUGEPAGE);
+#endif
+	chunk *c = (chunk *) start;
+	c->prev = chunks;
+	c->size = size;
+	chunks = c;
+	next = start + ARENA_ALIGN;
+	end = start + size;
+	usage.mapped += size;
+	usage.chunks++;
+}
+
+void *arena::alloc (size_t n) {
+	lock_guard<mutex> guard (lock);
+	n = (n + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+	if (!next || (size_t) (end - next) < n) new_chunk (n);
+	void *p = next;
+	next += n;
+	usage.allocated += n;
+	return p;
+}
+
+void arena::release (void) {
+	lock_guard<mutex> guard (lock);
+	while (chunks) {
+		chunk *c = chunks;
+		chunks = c->prev;
+		munmap (c, c->size);
+	}
+	next = end = NULL;
+	memset (&usage, 0, sizeof (usage));
+}
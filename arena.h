@@ -0,0 +1,64 @@
+#ifndef __ARENA_H
+#define __ARENA_H
+
+// the simulator's long-lived state (cache sets, replacement state) comes
+// from arenas instead of thousands of small new[]s. an arena maps chunks
+// of anonymous memory and hands out pieces aligned to host cache lines.
+// the chunks start small and double up to ARENA_CHUNK; one of a huge page
+// or more is 2MB aligned and marked MADV_HUGEPAGE so the sets can sit on
+// huge pages. nothing is freed piece by piece: each arena has an owner (a
+// cache, a replacement state, a simulator) that gives all of it back with
+// release (), or by deleting it, when it goes. DAN_HUGEPAGES=0 leaves the
+// chunks on normal pages.
+
+#include <stddef.h>
+#include <new>
+#include <mutex>
+
+#define ARENA_MIN_CHUNK	(256ull << 10)
+#define ARENA_CHUNK	(64ull << 20)	// the most reserved at a time; only touched pages are resident
+#define ARENA_HUGEPAGE	(2ull << 20)
+#define ARENA_ALIGN	64
+
+struct arena_stats {
+	unsigned long long int allocated;	// bytes handed out
+	unsigned long long int mapped;		// bytes reserved
+	int chunks;
+};
+
+class arena {
+	struct chunk {
+		chunk *prev;
+		size_t size;
+	};
+	chunk *chunks;		// the newest, which the others hang off
+	char *next, *end;	// what's left of it
+	std::mutex lock;
+	arena_stats usage;
+
+	void new_chunk (size_t n);
+
+public:
+	arena (void);
+	~arena (void) { release (); }
+	arena (const arena &) = delete;
+	arena &operator= (const arena &) = delete;
+
+	void *alloc (size_t n);
+
+	// unmap everything; whatever came from here is gone. the arena can
+	// be used again afterwards
+	void release (void);
+
+	const arena_stats *stats (void) { return &usage; }
+};
+
+// n default-constructed objects
+
+template <class T> T *arena_new (arena *a, size_t n) {
+	T *p = (T *) a->alloc (n * sizeof (T));
+	for (size_t i=0; i<n; i++) new (p + i) T;
+	return p;
+}
+
+#endif
@@ -4,13 +4,19 @@
 #include <assert.h>
 #include "utils.h"
 #include "replacement_state.h"
+#include "stats.h"
 #include "cache.h"
+#include "profile.h"
+#include "prefetch.h"
+#include "arena.h"
+#include "victim.h"
+#include "writebuf.h"
+#include "missprof.h"
+#include "telemetry.h"
 
 using namespace std;
 
-static unsigned int random_counter = 0;
-
-void place (cache *c, unsigned long long int pc, unsigned int set, block *b, int offset) {
+void place (cache *c, unsigned long long int pc, unsigned long long int address, unsigned int set, block *b, int offset) {
 	// which pc filled this block
 
 	b->filling_pc = pc;
@@ -18,6 +24,8 @@ void place (cache *c, unsigned long long int pc, unsigned int set, block *b, int
 	// which *byte* offset filled this block
 
 	b->offset = offset;
+	b->reused = false;
+	if (c->profiler) c->profiler->fill (pc, address);
 }
 
 // log base 2
@@ -33,12 +41,19 @@ int lg2 (int n) {
 }
 
 // make a cache.  hope blocksize and nsets are a power of 2.
-
-void init_cache (cache *c, int nsets, int assoc, int blocksize, int replacement_policy, int set_shift) {
-	int i, j;
-	c->sets = new set[nsets];
+// the sets, their blocks and replacement state come from mem, or from
+// an arena of the cache's own, already empty
+
+void init_cache (cache *c, int nsets, int assoc, int blocksize, int replacement_policy, int set_shift, arena *mem) {
+	assert (nsets <= MAX_SETS && assoc >= 1 && assoc <= MAX_ASSOC);
+	free_cache (c);
+	c->owns_mem = !mem;
+	c->mem = mem ? mem : new arena;
+	c->sets = arena_new<set> (c->mem, nsets);
+	c->blocks = arena_new<block> (c->mem, (size_t) nsets * assoc);
+	for (int i=0; i<nsets; i++) c->sets[i].blocks = c->blocks + (size_t) i * assoc;
 	c->replacement_policy = replacement_policy;
-	c->repl = new CACHE_REPLACEMENT_STATE (nsets, assoc, replacement_policy);
+	c->repl = new (c->mem->alloc (sizeof (CACHE_REPLACEMENT_STATE))) CACHE_REPLACEMENT_STATE (nsets, assoc, replacement_policy, c->mem);
 	c->set_shift = set_shift;
 	c->nsets = nsets;
 	c->assoc = assoc;
@@ -47,18 +62,52 @@ void init_cache (cache *c, int nsets, int assoc, int blocksize, int replacement_
 	c->index_bits = lg2 (nsets);
 	c->tagshiftbits = c->offset_bits + c->index_bits;
 	c->index_mask = nsets - 1;
+	c->way_mask = assoc >= 64 ? ~0ull : (1ull << assoc) - 1;
+	c->index_fn = INDEX_MODULO;
+	c->skew_groups = 1;
+	c->group_ways = assoc;
 	c->misses = 0;
 	c->accesses = 0;
+	c->way_predicted = c->way_mispredicted = 0;
 	memset (c->counts, 0, sizeof (c->counts));
-	for (i=0; i<nsets; i++) {
-		for (j=0; j<assoc; j++) {
-			block *b = &c->sets[i].blocks[j];
-			b->tag = 0;
-			b->valid = 0;
-			b->dirty = 0;
-		}
-		c->sets[i].valid = 0;
+}
+
+void free_cache (cache *c) {
+	if (c->repl) c->repl->~CACHE_REPLACEMENT_STATE ();
+	if (c->owns_mem) delete c->mem;
+	c->repl = NULL;
+	c->sets = NULL;
+	c->blocks = NULL;
+	c->mem = NULL;
+	c->owns_mem = false;
+}
+
+cache::~cache (void) {
+	free_cache (this);
+}
+
+bool cache_set_index (cache *c, int fn, int groups) {
+	if (fn == INDEX_SKEW) {
+		if (groups < 2 || groups > SKEW_GROUPS_MAX || c->assoc % groups) return false;
+		if (c->replacement_policy != REPLACEMENT_POLICY_LRU && c->replacement_policy != REPLACEMENT_POLICY_RANDOM) return false;
+		c->skew_groups = groups;
+	} else if (fn != INDEX_MODULO && fn != INDEX_XOR) return false;
+	else c->skew_groups = 1;
+	c->index_fn = fn;
+	c->group_ways = c->assoc / c->skew_groups;
+	return true;
+}
+
+// the address of the block with this tag in this set's way; the inverse of
+// cache_decode
+
+static inline unsigned long long int block_address (cache *c, unsigned long long int tag, unsigned int set, int way) {
+	if (c->index_fn == INDEX_MODULO) {
+		unsigned long long int low = tag & ((1ull << c->set_shift) - 1);
+		return (((((tag >> c->set_shift) << c->index_bits) | set) << c->set_shift) | low) << c->offset_bits;
 	}
+	unsigned int index = set ^ cache_hash (c, tag, way / c->group_ways);
+	return ((tag << c->index_bits) | index) << c->offset_bits;
 }
 
 // move a block to the MRU position
@@ -70,133 +119,367 @@ void move_to_mru (block *v, int i) {
 	v[0] = b;
 }
 
-// invalidate a block out of this cache! the block might not be there, but if it is, we'll blow it away
+// move a block to the LRU position
 
-void invalidate (cache *c, unsigned long long int address) {
-	int i, assoc = c->assoc;
-	block *v;
-	unsigned long long int block_addr = address >> c->offset_bits;
-	unsigned long long int tag = block_addr >> c->index_bits;
-	unsigned int set = (block_addr >> c->set_shift) & c->index_mask;
-	v = &c->sets[set].blocks[0];
-	for (i=0; i<assoc; i++) {
-		if (v[i].tag == tag) {
-			v[i].valid = 0;
-			c->invalidations++;
-			break;
+void move_to_lru (block *v, int i, int assoc) {
+	int j;
+	block b = v[i];
+	for (j=i; j<assoc-1; j++) v[j] = v[j+1];
+	v[assoc-1] = b;
+}
+
+// keep a set's masks in step with move_to_mru and move_to_lru on its blocks
+
+static inline unsigned long long int mask_to_mru (unsigned long long int m, int i) {
+	unsigned long long int below = m & ((1ull << i) - 1);
+	return (m & ~((2ull << i) - 1)) | (below << 1) | ((m >> i) & 1);
+}
+
+static inline unsigned long long int mask_to_lru (unsigned long long int m, int i, int assoc) {
+	unsigned long long int above = (m >> (i + 1)) & ((1ull << (assoc - i - 1)) - 1);
+	return (m & ((1ull << i) - 1)) | (above << i) | (((m >> i) & 1) << (assoc - 1));
+}
+
+static inline void set_to_mru (set *s, int i) {
+	move_to_mru (s->blocks, i);
+	s->valid_mask = mask_to_mru (s->valid_mask, i);
+	s->dirty_mask = mask_to_mru (s->dirty_mask, i);
+}
+
+static inline void set_to_lru (set *s, int i, int assoc) {
+	move_to_lru (s->blocks, i, assoc);
+	s->valid_mask = mask_to_lru (s->valid_mask, i, assoc);
+	s->dirty_mask = mask_to_lru (s->dirty_mask, i, assoc);
+}
+
+// the same within a skew group's ways, base up to base+k-1
+
+static inline unsigned long long int group_mask_to_mru (unsigned long long int m, int i, int base, int k) {
+	unsigned long long int field = ((1ull << k) - 1) << base;
+	return (m & ~field) | (mask_to_mru ((m & field) >> base, i - base) << base);
+}
+
+static inline unsigned long long int group_mask_to_lru (unsigned long long int m, int i, int base, int k) {
+	unsigned long long int field = ((1ull << k) - 1) << base;
+	return (m & ~field) | (mask_to_lru ((m & field) >> base, i - base, k) << base);
+}
+
+static inline void group_to_mru (set *s, int i, int base, int k) {
+	move_to_mru (s->blocks + base, i - base);
+	s->valid_mask = group_mask_to_mru (s->valid_mask, i, base, k);
+	s->dirty_mask = group_mask_to_mru (s->dirty_mask, i, base, k);
+}
+
+static inline void group_to_lru (set *s, int i, int base, int k) {
+	move_to_lru (s->blocks + base, i - base, k);
+	s->valid_mask = group_mask_to_lru (s->valid_mask, i, base, k);
+	s->dirty_mask = group_mask_to_lru (s->dirty_mask, i, base, k);
+}
+
+// a block was placed in a way
+
+static inline void set_fill (set *s, int i, bool dirty) {
+	s->blocks[i].valid = 1;
+	s->blocks[i].dirty = dirty;
+	s->valid_mask |= 1ull << i;
+	if (dirty) s->dirty_mask |= 1ull << i; else s->dirty_mask &= ~(1ull << i);
+}
+
+// valid or dirty blocks in the whole cache
+
+unsigned long long int cache_occupancy (cache *c, bool dirty) {
+	unsigned long long int n = 0;
+	for (int i=0; i<c->nsets; i++) n += __builtin_popcountll (dirty ? c->sets[i].dirty_mask : c->sets[i].valid_mask);
+	return n;
+}
+
+// translate from DAN_* to CRC's access types
+
+static AccessTypes access_type (int op) {
+	switch (op) {
+		case DAN_PREFETCH: return ACCESS_PREFETCH;
+		case DAN_DREAD: return ACCESS_LOAD;
+		case DAN_WRITE: return ACCESS_STORE;
+		case DAN_WRITEBACK: return ACCESS_WRITEBACK;
+		case DAN_IREAD: return ACCESS_IFETCH;
+		default:
+		printf ("op is %d!\n", op); fflush (stdout);
+		assert (0);
+	}
+	return ACCESS_LOAD;
+}
+
+int cache_find (cache *c, cache_ref *r) {
+	if (c->skew_groups > 1) {
+		int k = c->group_ways;
+		for (int g=0; g<c->skew_groups; g++) {
+			unsigned int set = skew_set (c, r, g);
+			block *v = &c->sets[set].blocks[0];
+			for (int i=g*k; i<(g+1)*k; i++) if (v[i].tag == r->tag && v[i].valid) {
+				r->set = set;
+				return i;
+			}
 		}
+		return -1;
+	}
+	block *v = &c->sets[r->set].blocks[0];
+	for (int i=0; i<c->assoc; i++) if (v[i].tag == r->tag && v[i].valid) return i;
+	return -1;
+}
+
+// invalidate the block in one way of a set, counting it against this cache
+
+static inline void invalidate_way (cache *c, unsigned int set, int way, unsigned int core, int op, int access_source) {
+	c->sets[set].blocks[way].valid = 0;
+	c->sets[set].valid_mask &= ~(1ull << way);
+	c->sets[set].dirty_mask &= ~(1ull << way);
+	c->invalidations++;
+	c->stats.count (STAT_INVALIDATE, core, access_type (op), access_source);
+}
+
+// invalidate a block out of this cache! the block might not be there, but if it is, we'll blow it away.
+// returns true if it was there, and sets *dirty if it was dirty too
+
+bool invalidate (cache *c, unsigned long long int address, unsigned int core, int op, int access_source, bool *dirty = NULL) {
+	cache_ref r;
+	PROF_BEGIN (PROF_INVALIDATE, prof_invalidate);
+	cache_decode (c, address, &r);
+	int i = cache_find (c, &r);
+	if (i >= 0) {
+		if (dirty && c->sets[r.set].blocks[i].dirty) *dirty = true;
+		invalidate_way (c, r.set, i, core, op, access_source);
+	}
+	PROF_END (PROF_INVALIDATE, prof_invalidate);
+	return i >= 0;
+}
+
+// is the block in this cache? no side effects
+
+bool cache_probe (cache *c, unsigned long long int address) {
+	cache_ref r;
+	cache_decode (c, address, &r);
+	return cache_find (c, &r) >= 0;
+}
+
+// tell the telemetry about a victim: which partition it came from and
+// where it was in the recency stack
+
+static inline void telemetry_evicted (cache *c, unsigned int set, int way, unsigned int core) {
+	bool dirty;
+	unsigned int pos;
+	if (c->replacement_policy >= REPLACEMENT_POLICY_CRC) {
+		dirty = c->repl->repl[set][way].dirtyBit;
+		pos = c->repl->repl[set][way].LRUstackposition;
+	} else {
+		dirty = c->sets[set].blocks[way].dirty;
+		pos = c->replacement_policy == REPLACEMENT_POLICY_LRU ? way % c->group_ways : way;
 	}
-	
+	c->telemetry->evicted (set, core, dirty, pos);
 }
 
-// access a cache, return true for miss, false for hit
+#define check_writeback(b) { c->last_victim = v[(b)].valid ? block_address (c, v[(b)].tag, set, (b)) : 0; if (c->profiler && v[(b)].valid) c->profiler->evicted (v[(b)].filling_pc, c->last_victim, !v[(b)].reused, v[(b)].dirty); if (c->telemetry && v[(b)].valid) telemetry_evicted (c, set, (b), core); if (writeback_address && v[(b)].valid && (v[(b)].dirty || c->writeback_clean)) { *writeback_address = c->last_victim; c->stats.count (STAT_WRITEBACK, core, at, access_source); } }
 
-#define check_writeback(b) { if (writeback_address && v[(b)].valid && (v[(b)].dirty || (assoc!=16))) *writeback_address = ((v[(b)].tag << c->index_bits) + set) << c->offset_bits; }
+// cache_access for a skewed cache. each group of ways is looked up in its
+// own set. a miss fills a free way in any of them, or else replaces in a
+// group chosen at random: its LRU way, or a random one. LRU order is kept
+// within each group, and CRC's instrumentation state isn't kept at all.
 
-bool cache_access (cache *c, unsigned long long int address, unsigned long long int pc, unsigned int size, int op, unsigned int core, unsigned long long int *writeback_address = NULL, bool do_place = true, int access_source = 0) {
+static bool skewed_access (cache *c, const cache_ref *r, unsigned long long int address, unsigned long long int pc, unsigned int size, int op, unsigned int core, unsigned long long int *writeback_address, bool do_place, int access_source, bool extract) {
 	c->counts[op]++;
-	int i, assoc = c->assoc;
-	block *v;
-	unsigned int offset = address & (c->blocksize - 1);
-	unsigned long long int block_addr = address >> c->offset_bits;
-	unsigned int set = (block_addr >> c->set_shift) & c->index_mask;
+	int i, g, k = c->group_ways;
+	bool lru = c->replacement_policy == REPLACEMENT_POLICY_LRU;
+	unsigned long long int tag = r->tag;
+	unsigned int sets[SKEW_GROUPS_MAX];
+
+	c->accesses++;
+	if (writeback_address) *writeback_address = 0;
+	AccessTypes at = access_type (op);
+
+	for (g=0; g<c->skew_groups; g++) {
+		unsigned int set = sets[g] = skew_set (c, r, g);
+		block *v = &c->sets[set].blocks[0];
+		for (i=g*k; i<(g+1)*k; i++) {
+			if (v[i].tag != tag || !v[i].valid) continue;
+			c->stats.count (STAT_HIT, core, at, access_source);
+			unsigned int pos = i - g*k;
+			c->stats.hit_position[pos < STATS_MAX_POSITIONS ? pos : STATS_MAX_POSITIONS-1]++;
+			if (at == ACCESS_STORE || at == ACCESS_WRITEBACK) {
+				v[i].dirty = true;
+				c->sets[set].dirty_mask |= 1ull << i;
+			}
+			v[i].reused = true;
+			if (v[i].prefetched && at != ACCESS_PREFETCH && at != ACCESS_WRITEBACK) {
+				v[i].prefetched = false;
+				c->prefetch_hits++;
+			}
+			if (lru && i != g*k) group_to_mru (&c->sets[set], i, g*k, k);
+			if (extract) {
+				PROF_BEGIN (PROF_INVALIDATE, prof_invalidate);
+				invalidate_way (c, set, lru ? g*k : i, core, op, access_source);
+				PROF_END (PROF_INVALIDATE, prof_invalidate);
+			}
+			return false;
+		}
+	}
 
-	// note this doesn't generate the right tag if we have a non-zero set shift
-	// we *do* need the right tag value for things like the sampler to work
-	// because the sampler recontstructs the physical address from the tag & index
+	c->misses++;
+	c->stats.count (STAT_MISS, core, at, access_source);
+	c->last_victim = 0;
+	if (c->profiler && at != ACCESS_WRITEBACK) c->profiler->miss (pc, address);
+	if (c->telemetry) c->telemetry->miss (r->set);
+	if (!do_place) return true;
+
+	i = -1;
+	for (g=0; g<c->skew_groups; g++) {
+		unsigned long long int free_ways = (~c->sets[sets[g]].valid_mask >> (g*k)) & ((1ull << k) - 1);
+		if (free_ways) {
+			i = g*k + __builtin_ctzll (free_ways);
+			break;
+		}
+	}
+	if (i < 0) {
+		g = c->random.next () % c->skew_groups;
+		i = g*k + (lru ? k - 1 : c->random.next () % k);
+	}
+	unsigned int set = sets[g];
+	block *v = &c->sets[set].blocks[0];
+	check_writeback (i);
+	int w = i;
+	if (lru) {
+		if (access_source >= ACCESS_7 && c->repl->LowPriorityPrefetch ()) {
+			w = g*k + k - 1;
+			if (i != w) group_to_lru (&c->sets[set], i, g*k, k);
+		} else {
+			w = g*k;
+			if (i != w) group_to_mru (&c->sets[set], i, g*k, k);
+		}
+	}
+	set_fill (&c->sets[set], w, at == ACCESS_STORE || at == ACCESS_WRITEBACK);
+	v[w].tag = tag;
+	v[w].prefetched = access_source >= ACCESS_7;
+	place (c, pc, address, set, &v[w], r->offset);
+	c->stats.count (STAT_FILL, core, at, access_source);
+	return true;
+}
 
-	unsigned long long int tag = block_addr >> c->index_bits;
+// access a cache, return true for miss, false for hit. r is the address
+// decoded for this cache. with extract, a hit also invalidates the block,
+// which is how an exclusive hierarchy moves a block up a level.
 
-	// this will be true if the current set contains only valid blocks, false otherwise
+bool cache_access (cache *c, const cache_ref *r, unsigned long long int address, unsigned long long int pc, unsigned int size, int op, unsigned int core, unsigned long long int *writeback_address, bool do_place, int access_source, bool extract) {
+	if (c->skew_groups > 1) return skewed_access (c, r, address, pc, size, op, core, writeback_address, do_place, access_source, extract);
+	c->counts[op]++;
+	int i, assoc = c->assoc;
+	block *v;
+	unsigned int offset = r->offset;
+	unsigned int set = r->set;
+	unsigned long long int tag = r->tag;
 
-	int set_valid = c->sets[set].valid;
-	set_valid = false; // we can get back-invalidations so we can't use this optimization here
 	c->accesses++;
 	v = &c->sets[set].blocks[0];
 	LINE_STATE ls;
 	if (writeback_address) *writeback_address = 0;
-	AccessTypes at;
-	switch (op) {
-		case DAN_PREFETCH: at = ACCESS_PREFETCH; break;
-		case DAN_DREAD: at = ACCESS_LOAD; break;
-		case DAN_WRITE: at = ACCESS_STORE; break;
-		case DAN_WRITEBACK: at = ACCESS_WRITEBACK; break;
-		case DAN_IREAD: at = ACCESS_IFETCH; break;
-		default: at = ACCESS_LOAD;
-		printf ("op is %d!\n", op); fflush (stdout);
-		assert (0);
+	AccessTypes at = access_type (op);
+
+	// tag match? try the way that last hit or was filled in this set
+	// first, then the rest. a tag is in at most one way, so this finds
+	// the same way the scan alone would
+
+	i = c->sets[set].mru;
+	if (v[i].tag == tag && v[i].valid) c->way_predicted++;
+	else {
+		for (i=0; i<assoc; i++) if (v[i].tag == tag && v[i].valid) break;
+		if (i < assoc) c->way_mispredicted++;
 	}
-	
-	// tag match?
-
-	for (i=0; i<assoc; i++) {
-		if (v[i].tag == tag && v[i].valid) {
-			if (at == ACCESS_STORE || at == ACCESS_WRITEBACK) v[i].dirty = true;
-			if (c->replacement_policy == REPLACEMENT_POLICY_LRU) {
-				// move this block to the mru position
-				if (i != 0) move_to_mru (v, i);
-				assert (i >= 0 && i < assoc);
-				// update CRC's LRU policy (for instrumentation)
-				ls.tag = tag;
-				if (at != ACCESS_WRITEBACK)
-					c->repl->UpdateReplacementState (set, i, &ls, core, pc, at, true, access_source);
-			} else if (c->replacement_policy >= REPLACEMENT_POLICY_CRC) {
-				ls.tag = tag;
-				assert (i >= 0 && i < assoc);
-				if (at != ACCESS_WRITEBACK)
-					c->repl->UpdateReplacementState (set, i, &ls, core, pc, at, true, access_source);
-			}
-			return false;
+	if (i < assoc) {
+		c->stats.count (STAT_HIT, core, at, access_source);
+		{
+			// LRU keeps ways in recency order; everyone else keeps stack positions in repl
+			unsigned int pos = (c->replacement_policy == REPLACEMENT_POLICY_LRU) ? i : c->repl->repl[set][i].LRUstackposition;
+			c->stats.hit_position[pos < STATS_MAX_POSITIONS ? pos : STATS_MAX_POSITIONS-1]++;
+		}
+		if (at == ACCESS_STORE || at == ACCESS_WRITEBACK) {
+			v[i].dirty = true;
+			c->sets[set].dirty_mask |= 1ull << i;
+		}
+		v[i].reused = true;
+		if (v[i].prefetched && at != ACCESS_PREFETCH && at != ACCESS_WRITEBACK) {
+			v[i].prefetched = false;
+			c->prefetch_hits++;
 		}
+		if (c->replacement_policy == REPLACEMENT_POLICY_LRU) {
+			// move this block to the mru position
+			if (i != 0) set_to_mru (&c->sets[set], i);
+			assert (i >= 0 && i < assoc);
+			// update CRC's LRU policy (for instrumentation)
+			ls.tag = tag;
+			if (at != ACCESS_WRITEBACK)
+				c->repl->UpdateReplacementState (set, i, &ls, core, pc, at, true, access_source);
+		} else if (c->replacement_policy >= REPLACEMENT_POLICY_CRC) {
+			ls.tag = tag;
+			assert (i >= 0 && i < assoc);
+			if (at != ACCESS_WRITEBACK)
+				c->repl->UpdateReplacementState (set, i, &ls, core, pc, at, true, access_source);
+		}
+		c->sets[set].mru = c->replacement_policy == REPLACEMENT_POLICY_LRU ? 0 : i;
+		if (extract) {
+			PROF_BEGIN (PROF_INVALIDATE, prof_invalidate);
+			invalidate_way (c, set, c->replacement_policy == REPLACEMENT_POLICY_LRU ? 0 : i, core, op, access_source);
+			PROF_END (PROF_INVALIDATE, prof_invalidate);
+		}
+		return false;
 	}
 
 	// a miss.
 
 	c->misses++;
+	c->stats.count (STAT_MISS, core, at, access_source);
+	c->last_victim = 0;
+	if (c->profiler && at != ACCESS_WRITEBACK) c->profiler->miss (pc, address);
+	if (c->telemetry) c->telemetry->miss (r->set);
 
 	// should we place this block in the cache? if not, just return
 
 	if (!do_place) return true;
 
-	// find a block to replace
+	// find a block to replace: the first invalid one, or if there
+	// isn't one, whatever the policy says
 
-	if (!set_valid) {
-		for (i=0; i<assoc; i++) {
-			if (v[i].valid == 0) break;
-		}
-		if (i == assoc) {
-			c->sets[set].valid = 1; // mark this set as having only valid blocks so we don't search it again
-			set_valid = 1;
-		}
-		// at this point, i indicates an invalid block, or assoc if there is no invalid block
-	}
+	unsigned long long int free_ways = ~c->sets[set].valid_mask & c->way_mask;
+	int set_valid = free_ways == 0;
+	i = set_valid ? assoc : __builtin_ctzll (free_ways);
 	if (c->replacement_policy == REPLACEMENT_POLICY_RANDOM) {
 
 		// if no invalid block, choose a random one
 
-		if (set_valid) i = (random_counter++) % assoc; // replace
+		if (set_valid) i = c->random.next () % assoc; // replace
 		check_writeback (i);
-		if (at == ACCESS_STORE || at == ACCESS_WRITEBACK) 
-			v[i].dirty = true;
-		else
-			v[i].dirty = false;
+		set_fill (&c->sets[set], i, at == ACCESS_STORE || at == ACCESS_WRITEBACK);
 		v[i].tag = tag;
-		v[i].valid = 1;
-		place (c, pc, set, &v[i], offset);
+		v[i].prefetched = access_source >= ACCESS_7;
+		place (c, pc, address, set, &v[i], offset);
+		c->sets[set].mru = i;
+		c->stats.count (STAT_FILL, core, at, access_source);
 	} else if (c->replacement_policy == REPLACEMENT_POLICY_LRU) {
 
 		// if no invalid block, use the lru one (the one in the last position)
 
 		if (set_valid) i = assoc - 1; // replace LRU block
 		check_writeback (i);
-		if (i != 0) move_to_mru (v, i);
-		if (at == ACCESS_STORE || at == ACCESS_WRITEBACK) 
-			v[0].dirty = true;
-		else
-			v[0].dirty = false;
-		v[0].tag = tag;
-		v[0].valid = 1;
-		place (c, pc, set, &v[0], offset);
+
+		// prefetcher fills may go in at the LRU end instead
+
+		int w = 0;
+		if (access_source >= ACCESS_7 && c->repl->LowPriorityPrefetch ()) {
+			if (i != assoc - 1) set_to_lru (&c->sets[set], i, assoc);
+			w = assoc - 1;
+		} else if (i != 0) set_to_mru (&c->sets[set], i);
+		set_fill (&c->sets[set], w, at == ACCESS_STORE || at == ACCESS_WRITEBACK);
+		v[w].tag = tag;
+		v[w].prefetched = access_source >= ACCESS_7;
+		place (c, pc, address, set, &v[w], offset);
+		c->sets[set].mru = w;
+		c->stats.count (STAT_FILL, core, at, access_source);
 
 		// update CRC's LRU policy (for instrumentation)
 		ls.tag = tag;
@@ -218,15 +501,17 @@ bool cache_access (cache *c, unsigned long long int address, unsigned long long
 
 		if (i != -1) {
 			check_writeback (i);
-			if (at == ACCESS_STORE || at == ACCESS_WRITEBACK) 
-				v[i].dirty = true;
-			else
-				v[i].dirty = false;
+			set_fill (&c->sets[set], i, at == ACCESS_STORE || at == ACCESS_WRITEBACK);
 			v[i].tag = tag;
-			v[i].valid = 1;
+			v[i].prefetched = access_source >= ACCESS_7;
 			assert (i >= 0 && i < assoc);
 			c->repl->UpdateReplacementState (set, i, &ls, core, pc, at, false, access_source);
-			place (c, pc, set, &v[i], offset);
+			place (c, pc, address, set, &v[i], offset);
+			c->sets[set].mru = i;
+			c->stats.count (STAT_FILL, core, at, access_source);
+		} else {
+			c->stats.count (STAT_BYPASS, core, at, access_source);
+			if (c->profiler) c->profiler->bypass (pc, address);
 		}
 	}
 	// only count as a miss if the block is not a writeback block or prefetch
@@ -240,59 +525,418 @@ bool cache_access (cache *c, unsigned long long int address, unsigned long long
 // bit 0 set if there is a miss in L1
 // bit 1 set if there is a miss in L2
 // bit 2 set if there is a miss in L3
+// and so on for the other MISS_* bits. if memory_writebacks isn't NULL it
+// points to MEMORY_WRITEBACKS addresses that get any dirty blocks written
+// back to memory, or 0.
 
 // private L1 and L2, shared L3
 
-unsigned int memory_access (cache *L1, cache *L2, cache *L3, unsigned long long int address, unsigned long long int pc, unsigned int size, int op, unsigned int core) {
-	// access the memory hierarchy, returning latency of access
+#ifdef PROFILE
+// finish timing memory_access, charging the sample to the path the access took as well.
+// the path is where the demand access was satisfied; MISS_L3_DEMAND is
+// also set when a writeback misses in the LLC, so memory reads decide the
+// LLC miss path. accesses that wrote victims back are counted again on
+// their own
+
+static inline void prof_end_path (unsigned int miss, unsigned long long int t) {
+	int path;
+	if (!(miss & MISS_L1_DEMAND)) path = PROF_PATH_L1_HIT;
+	else if (!(miss & MISS_L2_DEMAND)) path = PROF_PATH_L2_HIT;
+	else if (!(miss & MISS_MEMORY_READ)) path = PROF_PATH_L3_HIT;
+	else path = PROF_PATH_L3_MISS;
+	bool writebacks = miss & (MISS_L1_WRITEBACK | MISS_L2_WRITEBACK | MISS_L3_WRITEBACK);
+	prof_stages[path].calls++;
+	if (writebacks) prof_stages[PROF_PATH_WRITEBACKS].calls++;
+	if (t) {
+		unsigned long long int d = prof_now () - t;
+		prof_stages[PROF_MEMORY_ACCESS].cycles += d;
+		prof_stages[PROF_MEMORY_ACCESS].samples++;
+		prof_stages[path].cycles += d;
+		prof_stages[path].samples++;
+		if (writebacks) {
+			prof_stages[PROF_PATH_WRITEBACKS].cycles += d;
+			prof_stages[PROF_PATH_WRITEBACKS].samples++;
+		}
+	}
+}
+
+void prof_count_path (unsigned int miss) {
+	prof_stages[PROF_MEMORY_ACCESS].calls++;
+	prof_end_path (miss, 0);
+}
+#endif
+
+// dirty blocks on their way to memory
+
+struct writeback_list {
+	unsigned long long int *addr;
+	int n, max;
+
+	void add (unsigned long long int a) { if (n < max) addr[n++] = a; }
+};
+
+// inclusive and non-inclusive hierarchies. misses fill every level on the
+// way up, and only dirty victims move down, as DAN_WRITEBACKs that allocate
+// if the block isn't there. when an inclusive L2 or LLC loses a block it
+// is invalidated out of the levels above (with access source 0), and if a
+// copy up there was dirty the victim is too.
+
+static void write_down (int level, cache *L1, cache *L2, cache *L3, unsigned long long int victim, unsigned long long int pc, unsigned int size, unsigned int core, unsigned int *miss, writeback_list *mem);
+
+// a fill at this level replaced victim, or nothing if it is 0
+
+static void evicted (int level, cache *L1, cache *L2, cache *L3, unsigned long long int victim, bool dirty, unsigned long long int pc, unsigned int size, unsigned int core, unsigned int *miss, writeback_list *mem) {
+	if (!victim) return;
+	if (L3->inclusion == INCLUSION_INCLUSIVE && level > 1) {
+		// the L2 is private; the LLC's victim could be in any core's caches
+		cache *c = level == 2 ? &L2[core] : L3;
+		int first = level == 2 ? core : 0, last = level == 2 ? core : L3->sharers - 1;
+		for (int k=first; k<=last; k++) {
+			bool d = false, found = invalidate (&L1[k], victim, core, DAN_WRITEBACK, 0, &d);
+			if (level == 3) found = invalidate (&L2[k], victim, core, DAN_WRITEBACK, 0, &d) || found;
+			if (found) {
+				c->back_invalidations++;
+				if (d) c->back_invalidations_dirty++;
+			}
+			dirty = dirty || d;
+		}
+	}
+	if (dirty) {
+		*miss |= level == 1 ? MISS_L1_WRITEBACK : level == 2 ? MISS_L2_WRITEBACK : MISS_L3_WRITEBACK;
+		write_down (level + 1, L1, L2, L3, victim, pc, size, core, miss, mem);
+	}
+}
+
+static void write_down (int level, cache *L1, cache *L2, cache *L3, unsigned long long int victim, unsigned long long int pc, unsigned int size, unsigned int core, unsigned int *miss, writeback_list *mem) {
+	if (level > 3) {
+		mem->add (victim);
+		return;
+	}
+	cache *c = level == 2 ? &L2[core] : L3;
+	unsigned long long int wb;
+	if (cache_access (c, victim, pc, size, DAN_WRITEBACK, core, &wb, true, level == 2 ? ACCESS_4 : ACCESS_5))
+		evicted (level, L1, L2, L3, c->last_victim, wb != 0, pc, size, core, miss, mem);
+}
+
+// a demand access in an inclusive or non-inclusive hierarchy. pf_target
+// and pf_trigger are as in memory_access.
+
+static unsigned int fill_all (cache *L1, cache *L2, cache *L3, unsigned long long int address, unsigned long long int pc, unsigned int size, int op, unsigned int core, writeback_list *mem, cache *pf_target, int *pf_trigger) {
 	unsigned int miss = 0;
+	unsigned long long int wb;
+
+	// stores only dirty the L1 copy; the levels below see a read
+
+	int fill_op = op == DAN_WRITE ? DAN_DREAD : op;
+	PROF_BEGIN (PROF_L1, prof_l1);
+	bool missL1 = cache_access (&L1[core], address, pc, size, op, core, &wb, true, ACCESS_1);
+	PROF_END (PROF_L1, prof_l1);
+	if (!missL1) return miss;
+	miss |= MISS_L1_DEMAND;
+	evicted (1, L1, L2, L3, L1[core].last_victim, wb != 0, pc, size, core, &miss, mem);
+
+	PROF_BEGIN (PROF_L2, prof_l2);
+	bool missL2 = cache_access (&L2[core], address, pc, size, fill_op, core, &wb, true, ACCESS_2);
+	PROF_END (PROF_L2, prof_l2);
+	if (pf_target == &L2[core]) *pf_trigger = missL2 ? 2 : 1;
+	if (!missL2) return miss;
+	miss |= MISS_L2_DEMAND;
+	evicted (2, L1, L2, L3, L2[core].last_victim, wb != 0, pc, size, core, &miss, mem);
+
+	PROF_BEGIN (PROF_L3, prof_l3);
+	bool missL3 = cache_access (L3, address, pc, size, fill_op, core, &wb, true, ACCESS_3);
+	PROF_END (PROF_L3, prof_l3);
+	if (pf_target == L3) *pf_trigger = missL3 ? 2 : 1;
+	if (!missL3) return miss;
+	miss |= MISS_L3_DEMAND | MISS_MEMORY_READ;
+	evicted (3, L1, L2, L3, L3->last_victim, wb != 0, pc, size, core, &miss, mem);
+	return miss;
+}
 
-	unsigned long long int wbl1;
-	unsigned int missL1 = cache_access (&L1[core], address, pc, size, op, core, &wbl1, true, ACCESS_1);
-        if (missL1) {
-                miss |= MISS_L1_DEMAND;
-		unsigned long long int wbl2;
-
-		// see if the block is in the L2, but don't place it there if not
-
-		unsigned int missL2 = cache_access (&L2[core], address, pc, size, op, core, &wbl2, false, ACCESS_2);
-		if (missL2) {
-			miss |= MISS_L2_DEMAND;
-			unsigned long long int wbl3;
-			// see if the block is in the shared LLC, but don't place it there if not
-			bool missL3 = cache_access (L3, address, pc, size, op, core, &wbl3, false, ACCESS_3);
-			if (missL3) miss |= MISS_L3_DEMAND;
-			// if it is there, we need to invalidate out of the L2 and L3 for the L1 demand access
-			invalidate (L3, address);
-			invalidate (L2, address);
-		} else {
-			// no miss from L2; invalidate this out of the L2 if it is there
-			invalidate (L2, address);
+// an access to the exclusive LLC that missed and filled replaced
+// L3->last_victim, dirty if wb isn't 0. with a victim buffer the block
+// goes there, and whatever that pushes out goes to memory instead; returns
+// the block for memory, or 0
+
+static unsigned long long int llc_evicted (cache *L3, bool missed, unsigned long long int wb) {
+	if (!L3->victims || !missed || !L3->last_victim) return wb;
+	return L3->victims->insert (L3->last_victim, wb != 0);
+}
+
+// with a victim buffer, a block missing from the exclusive LLC may still
+// be on chip: take it out of the buffer if it is there
+
+static inline bool in_victims (cache *L3, unsigned long long int address, int op) {
+	return L3->victims && L3->victims->extract (address & ~(unsigned long long int) (L3->blocksize - 1), access_type (op));
+}
+
+// with a write buffer, a block missing from the exclusive LLC may still be
+// on its way in: forward it up from there
+
+static inline bool in_write_buffer (cache *L3, unsigned long long int address) {
+	return L3->write_buf && L3->write_buf->forward (address & ~(unsigned long long int) (L3->blocksize - 1));
+}
+
+// is the block waiting in the LLC's write buffer? no side effects
+
+static inline bool write_buffered (cache *L3, unsigned long long int address) {
+	return L3->write_buf && L3->write_buf->contains (address & ~(unsigned long long int) (L3->blocksize - 1));
+}
+
+// an L2 victim on its way into the exclusive LLC. with a write buffer it
+// goes there instead, and only an entry that pushes out goes on into the
+// LLC. returns the LLC's miss bits, and *wbl3 gets the block for memory,
+// or 0
+
+static unsigned int llc_write (cache *L3, unsigned long long int victim, unsigned long long int pc, unsigned int size, unsigned int core, unsigned long long int *wbl3) {
+	unsigned int miss = 0;
+	*wbl3 = 0;
+	if (L3->write_buf) {
+		writebuf_entry e;
+		if (!L3->write_buf->write (victim, pc, core, &e)) return miss;
+		victim = e.block;
+		pc = e.pc;
+		core = e.core;
+	}
+	cache_ref r;
+	cache_decode (L3, victim, &r);
+	unsigned int missL3 = cache_access (L3, &r, victim, pc, size, DAN_WRITEBACK, core, wbl3, true, ACCESS_5);
+	// a block the victim buffer sent up is back: the LLC let it go too
+	// early, which its policy hears about
+	bool was_dirty;
+	if (L3->victims && L3->victims->returned (victim, &was_dirty)) L3->repl->EarlyReuse (core, r.set, was_dirty);
+	*wbl3 = llc_evicted (L3, missL3, *wbl3);
+	if (*wbl3) miss |= MISS_L3_WRITEBACK;
+	// what if we missed didn't write back to DRAM?
+	if (missL3) miss |= MISS_L3_DEMAND;
+	return miss;
+}
+
+// the prefetcher stage: see prefetch.h. target is the cache the prefetcher
+// is attached to, and hits what its count of demand hits on prefetched
+// blocks was before this access.
+
+static void prefetch (cache *L1, cache *L2, cache *L3, prefetcher *pf, cache *target, unsigned long long int hits, unsigned long long int address, unsigned long long int pc, unsigned int size, unsigned int core, bool miss) {
+	unsigned long long int candidates[PF_MAX_DEGREE], wb, wb3;
+	writeback_list mem = { pf->memory_writes, 0, PF_MAX_WRITES };
+	unsigned int ignored = 0;
+	if (target->prefetch_hits != hits) pf->demand_hit (address);
+	if (miss) pf->demand_miss (address);
+	int n = pf->train (address, pc, miss, candidates);
+	for (int k=0; k<n; k++) {
+		unsigned long long int a = candidates[k];
+		if (cache_probe (&L1[core], a) || cache_probe (&L2[core], a) || (target == L3 && (cache_probe (L3, a) || write_buffered (L3, a)))) {
+			pf->stats.redundant++;
+			continue;
 		}
-		if (wbl1) {
-			miss |= MISS_L1_WRITEBACK;
-			// generate a writeback to L2
-			unsigned long long int wbl2;
-			// place this L1 victim in the L2
-			(void) cache_access (&L2[core], wbl1, pc, size, DAN_WRITEBACK, core, &wbl2, true, ACCESS_4);
-			if (wbl2) {
-				// this writeback generated its own writeback
-				miss |= MISS_L2_WRITEBACK;
-				unsigned long long int wbl3;
-				// place this L2 victim in the LLC
-				unsigned int missL3 = cache_access (L3, wbl2, pc, size, DAN_WRITEBACK, core, &wbl3, true, ACCESS_5);
-				if (wbl3) miss |= MISS_L3_WRITEBACK;
-				// what if we missed didn't write back to DRAM?
-				if (missL3) miss |= MISS_L3_DEMAND;
+		cache_ref r3;
+		cache_decode (L3, a, &r3);
+		int llc_way = target != L3 ? cache_find (L3, &r3) : -1;
+		bool in_llc = llc_way >= 0;
+		if (L3->inclusion != INCLUSION_EXCLUSIVE) {
+			// fill the LLC unless it has the block, then the L2 if that's the target
+			if (!in_llc) {
+				if (cache_access (L3, a, pc, size, DAN_PREFETCH, core, &wb, true, target == L3 ? ACCESS_8 : ACCESS_7)) {
+					if (target == L3) pf->evicted (L3->last_victim);
+					evicted (3, L1, L2, L3, L3->last_victim, wb != 0, pc, size, core, &ignored, &mem);
+				}
+			}
+			if (target != L3 && cache_access (&L2[core], a, pc, size, DAN_PREFETCH, core, &wb, true, ACCESS_7)) {
+				pf->evicted (L2[core].last_victim);
+				evicted (2, L1, L2, L3, L2[core].last_victim, wb != 0, pc, size, core, &ignored, &mem);
+			}
+		} else if (target == L3) {
+			// from the victim buffer if it has the block
+			in_llc = in_victims (L3, a, DAN_PREFETCH);
+			bool missed = cache_access (L3, a, pc, size, DAN_PREFETCH, core, &wb, true, ACCESS_8);
+			if (L3->profiler && missed && !in_llc) L3->profiler->read (pc, a);
+			pf->evicted (L3->last_victim);
+			wb = llc_evicted (L3, missed, wb);
+			if (wb) mem.add (wb);
+		} else {
+			// into the L2, moving the block up if the LLC, its write
+			// buffer or its victim buffer has it
+			if (in_llc) invalidate_way (L3, r3.set, llc_way, core, DAN_PREFETCH, ACCESS_7);
+			else in_llc = in_write_buffer (L3, a) || in_victims (L3, a, DAN_PREFETCH);
+			if (L3->profiler) {
+				if (in_llc) L3->profiler->supplied (a);
+				else L3->profiler->read (pc, a);
+			}
+			(void) cache_access (&L2[core], a, pc, size, DAN_PREFETCH, core, &wb, true, ACCESS_7);
+			pf->evicted (L2[core].last_victim);
+			if (wb) {
+				(void) llc_write (L3, wb, pc, size, core, &wb3);
+				if (wb3) mem.add (wb3);
 			}
 		}
+		if (in_llc) {
+			pf->stats.from_llc++;
+			pf->issued (a, PF_LLC_LATENCY);
+		} else {
+			pf->memory_reads[pf->nreads++] = a;
+			pf->issued (a, pf->memory_latency);
+		}
+	}
+	pf->nwrites = mem.n;
+}
+
+// start bringing in the host cache lines a lookup in c's set for address
+// will read: the blocks' tags and the policy's state for the set. blocks
+// and policy state needn't start on a line, so cover every line they touch
+
+static inline void prefetch_lines (const void *p, size_t n, bool write) {
+	const char *q = (const char *) ((unsigned long long int) p & ~63ull), *end = (const char *) p + n;
+	for (; q<end; q+=64) {
+		if (write) __builtin_prefetch (q, 1);
+		else __builtin_prefetch (q);
+	}
+}
+
+void cache_prefetch_set (cache *c, unsigned long long int address) {
+	cache_ref r;
+	cache_decode (c, address, &r);
+	if (c->skew_groups > 1) {
+		for (int g=0; g<c->skew_groups; g++) {
+			unsigned int set = skew_set (c, &r, g);
+			prefetch_lines (c->blocks + (size_t) set * c->assoc + g * c->group_ways, c->group_ways * sizeof (block), false);
+			__builtin_prefetch (&c->sets[set], 1);
+		}
+		return;
+	}
+	prefetch_lines (c->blocks + (size_t) r.set * c->assoc, c->assoc * sizeof (block), false);
+	__builtin_prefetch (&c->sets[r.set], 1);
+	prefetch_lines (c->repl->repl[r.set], c->assoc * sizeof (LINE_REPLACEMENT_STATE), true);
+}
+
+void memory_prefetch (cache *L1, cache *L2, cache *L3, unsigned long long int address, unsigned int core) {
+	cache_prefetch_set (&L1[core], address);
+	cache_prefetch_set (&L2[core], address);
+	cache_prefetch_set (L3, address);
+}
+
+// the exclusive hierarchy in two halves. the core's L1 and L2 don't depend
+// on what happens in the LLC: a miss fills the L1 either way, and the L1's
+// victim goes to the L2. so private_access does that much and leaves in
+// req what the LLC has to do, in order: look for the block if it missed
+// in the L2 too, then take the L2's victim.
+
+unsigned int private_access (cache *L1, cache *L2, unsigned long long int address, unsigned long long int pc, unsigned int size, int op, unsigned int core, llc_request *req) {
+	unsigned int miss = 0;
+	req->address = address;
+	req->pc = pc;
+	req->size = size;
+	req->op = op;
+	req->core = core;
+	req->probe = false;
+	req->victim = 0;
+
+	// each level decodes the address once; a hit in the L2 moves the
+	// block up, so it is extracted by the same lookup
+
+	cache_ref r;
+	unsigned long long int wbl1;
+	PROF_BEGIN (PROF_L1, prof_l1);
+	cache_decode (&L1[core], address, &r);
+	unsigned int missL1 = cache_access (&L1[core], &r, address, pc, size, op, core, &wbl1, true, ACCESS_1);
+	PROF_END (PROF_L1, prof_l1);
+	if (!missL1) return miss;
+	miss |= MISS_L1_DEMAND;
+
+	// see if the block is in the L2, but don't place it there if not
+
+	unsigned long long int wbl2;
+	PROF_BEGIN (PROF_L2, prof_l2);
+	cache_decode (&L2[core], address, &r);
+	unsigned int missL2 = cache_access (&L2[core], &r, address, pc, size, op, core, &wbl2, false, ACCESS_2, true);
+	PROF_END (PROF_L2, prof_l2);
+	if (missL2) {
+		miss |= MISS_L2_DEMAND;
+		req->probe = true;
+	}
+	if (wbl1) {
+		miss |= MISS_L1_WRITEBACK;
+		// place this L1 victim in the L2
+		PROF_BEGIN (PROF_L2, prof_l2);
+		cache_decode (&L2[core], wbl1, &r);
+		(void) cache_access (&L2[core], &r, wbl1, pc, size, DAN_WRITEBACK, core, &wbl2, true, ACCESS_4);
+		PROF_END (PROF_L2, prof_l2);
 		if (wbl2) {
-			// generate a writeback to L3
-			if (miss & MISS_L2_WRITEBACK) miss |= MISS_L2_2ND_WRITEBACK; else miss |= MISS_L2_WRITEBACK;
-			unsigned long long int wbl3;
-			unsigned int missL3 = cache_access (L3, wbl2, pc, size, DAN_WRITEBACK, core, &wbl3, true, ACCESS_6);
-			if (missL3) { if (miss & MISS_L3_WRITEBACK) miss |= MISS_L3_2ND_WRITEBACK; } else miss |= MISS_L3_WRITEBACK;
+			// this writeback generated its own writeback
+			miss |= MISS_L2_WRITEBACK;
+			req->victim = wbl2;
+		}
+	}
+	return miss;
+}
+
+// the LLC's half: returns its miss bits and sets req->probe_miss.
+// memory_writebacks[0] gets the LLC's dirty victim, if any
+
+unsigned int llc_access (cache *L3, llc_request *req, unsigned long long int *memory_writebacks) {
+	unsigned int miss = 0;
+	cache_ref r;
+	unsigned long long int wbl3;
+	req->probe_miss = false;
+	if (req->probe) {
+		// see if the block is in the shared LLC, but don't place it there if not
+		PROF_BEGIN (PROF_L3, prof_l3);
+		cache_decode (L3, req->address, &r);
+		req->probe_miss = cache_access (L3, &r, req->address, req->pc, req->size, req->op, req->core, &wbl3, false, ACCESS_3, true);
+		if (req->probe_miss && (in_write_buffer (L3, req->address) || in_victims (L3, req->address, req->op))) req->probe_miss = false;
+		PROF_END (PROF_L3, prof_l3);
+		if (req->probe_miss) miss |= MISS_L3_DEMAND | MISS_MEMORY_READ;
+		if (L3->profiler) {
+			unsigned long long int b = req->address & ~(unsigned long long int) (L3->blocksize - 1);
+			if (req->probe_miss) L3->profiler->read (req->pc, b);
+			else L3->profiler->supplied (b);
+		}
+	}
+	if (req->victim) {
+		// place this L2 victim in the LLC
+		PROF_BEGIN (PROF_L3, prof_l3);
+		miss |= llc_write (L3, req->victim, req->pc, req->size, req->core, &wbl3);
+		PROF_END (PROF_L3, prof_l3);
+		if (memory_writebacks) memory_writebacks[0] = wbl3;
+	}
+	return miss;
+}
+
+unsigned int memory_access (cache *L1, cache *L2, cache *L3, unsigned long long int address, unsigned long long int pc, unsigned int size, int op, unsigned int core, unsigned long long int *memory_writebacks, prefetcher *pf) {
+	// access the memory hierarchy, returning latency of access
+	unsigned int miss = 0;
+	if (memory_writebacks) for (int k=0; k<MEMORY_WRITEBACKS; k++) memory_writebacks[k] = 0;
+
+	// the prefetcher trains on demand accesses that get to its level;
+	// pf_trigger is 1 if this one did and 2 if it also missed there
+
+	cache *pf_target = NULL;
+	unsigned long long int pf_hits = 0;
+	int pf_trigger = 0;
+	if (pf && pf->kind != PF_NONE) {
+		pf->nreads = pf->nwrites = 0;
+		pf->wait = 0;
+		if (op != DAN_PREFETCH && op != DAN_WRITEBACK) {
+			pf_target = pf->level == 3 ? L3 : &L2[core];
+			pf_hits = pf_target->prefetch_hits;
 		}
 	}
+	PROF_BEGIN (PROF_MEMORY_ACCESS, prof_access);
+
+	if (L3->inclusion != INCLUSION_EXCLUSIVE) {
+		unsigned long long int local[MEMORY_WRITEBACKS];
+		writeback_list mem = { memory_writebacks ? memory_writebacks : local, 0, MEMORY_WRITEBACKS };
+		miss = fill_all (L1, L2, L3, address, pc, size, op, core, &mem, pf_target, &pf_trigger);
+		if (pf_trigger) prefetch (L1, L2, L3, pf, pf_target, pf_hits, address, pc, size, core, pf_trigger == 2);
+		PROF_END_PATH (miss, prof_access);
+		return miss;
+	}
+
+	llc_request req;
+	miss = private_access (L1, L2, address, pc, size, op, core, &req);
+	if (pf_target == &L2[core] && (miss & MISS_L1_DEMAND)) pf_trigger = (miss & MISS_L2_DEMAND) ? 2 : 1;
+	miss |= llc_access (L3, &req, memory_writebacks);
+	if (pf_target == L3 && req.probe) pf_trigger = req.probe_miss ? 2 : 1;
+	if (pf_trigger) prefetch (L1, L2, L3, pf, pf_target, pf_hits, address, pc, size, core, pf_trigger == 2);
+	PROF_END_PATH (miss, prof_access);
 	return miss;
 }
@@ -1,7 +1,7 @@
 // quick and dirty cache simulation
 
-#define MAX_SETS	(1<<19)
-#define MAX_ASSOC	16
+#define MAX_SETS	(1<<22)
+#define MAX_ASSOC	64	// a set's masks have a bit per way
 #define WORDSIZE	4
 
 #define DAN_IREAD       0
@@ -31,6 +31,35 @@
 #define MISS_L3_WRITEBACK       0x0020
 #define MISS_L2_2ND_WRITEBACK   0x0040
 #define MISS_L3_2ND_WRITEBACK   0x0040
+#define MISS_MEMORY_READ        0x0080	// the block was read from memory, i.e. missed everywhere
+
+// how the levels relate. exclusive: a block lives in one level at a time,
+// L2 and LLC are filled only by victims from above. inclusive: demand
+// misses fill every level and a block leaving the L2 or LLC is invalidated
+// out of the levels above. non-inclusive: misses fill every level, with no
+// back-invalidation. DAN_INCLUSION picks one, exclusive by default; the
+// LLC's inclusion field holds it for memory_access.
+
+#define INCLUSION_EXCLUSIVE	0
+#define INCLUSION_INCLUSIVE	1
+#define INCLUSION_NONINCLUSIVE	2
+
+// how a cache picks the set for a block. modulo: the index bits just above
+// the offset (and set_shift). xor: those bits XORed with the rest of the
+// block address folded down to the same width, so power-of-two strides
+// spread over every set. skew: the ways are split into groups and each
+// group has its own hash, the first the same as xor's, so blocks that
+// collide in one group's set usually don't in another's. the hashed modes
+// ignore set_shift. cache_set_index picks one; modulo is the default.
+
+#define INDEX_MODULO	0
+#define INDEX_XOR	1
+#define INDEX_SKEW	2
+
+#define SKEW_GROUPS_MAX	8
+
+// most dirty blocks one memory_access can send to memory
+#define MEMORY_WRITEBACKS	4
 
 #define ACCESS_1		1	// first access to L1
 #define ACCESS_2		2	// access to L2 on L1 miss
@@ -38,53 +67,213 @@
 #define ACCESS_4		4	// writeback to L2 on eviction from L1
 #define ACCESS_5		5	// writeback to L3 on eviction from L2
 #define ACCESS_6		6	// second writeback to L3 on eviction from L2
+#define ACCESS_7		7	// prefetcher fill into L2
+#define ACCESS_8		8	// prefetcher fill into L3
 
 struct block {
-	unsigned int lru_stack_position;
 	unsigned long long int tag;
-	unsigned char valid, dirty;
 	unsigned long long int filling_pc; // pc that filled this block
 	int offset; // offset of *byte* that caused this line to be filled
+	unsigned char valid, dirty;
+	unsigned char prefetched; // filled by the prefetcher and not used yet
+	unsigned char reused; // hit since it was placed
 
 	block (void) {
 		offset = 0;
 		dirty = false;
 		valid = false;
+		prefetched = false;
+		reused = false;
 		tag = 0;
 	}
 };
 
+// a set's blocks are the cache's assoc of them for this set, so a set
+// takes only as much memory as its ways
+
 struct set {
-	block blocks[MAX_ASSOC];
-	unsigned char valid; // means entire set is valid
+	// bit i mirrors blocks[i].valid and, for valid blocks, blocks[i].dirty,
+	// so finding a free way or counting dirty blocks needs no scan
+	unsigned long long int valid_mask, dirty_mask;
+	block *blocks;
+	unsigned char mru;	// the way that last hit or was filled, which a lookup tries first
 
 	set (void) {
-		valid = false;
-		for (int i=0; i<MAX_ASSOC; i++) {
-			blocks[i].lru_stack_position = i;
-		}
+		valid_mask = 0;
+		dirty_mask = 0;
+		blocks = NULL;
+		mru = 0;
 	}
 };
 
+class arena;
+class victim_buffer;
+class write_buffer;
+class miss_profiler;
+class set_telemetry;
+
 struct cache {
 	int	nsets, assoc, blocksize, set_shift;
+	int	index_fn;		// INDEX_*
+	int	skew_groups, group_ways;	// for INDEX_SKEW, how many groups of how many ways; else 1 of assoc
 	int	offset_bits, index_bits, replacement_policy, tagshiftbits;
 	unsigned int index_mask;
+	unsigned long long int way_mask;	// a bit for each way
 	unsigned long long misses, accesses, invalidations;
+	unsigned long long prefetch_hits;	// demand hits on prefetched blocks
+	unsigned long long way_predicted, way_mispredicted;	// hits found in the set's mru way, and elsewhere
+	unsigned long long last_victim;		// address of the block the last fill replaced, or 0
+	unsigned long long back_invalidations;	// blocks this cache's victims invalidated out of the levels above
+	unsigned long long back_invalidations_dirty;	// of those, the ones with a dirty copy up there
+	bool writeback_clean;	// clean victims move down too, as in an exclusive hierarchy's L1 and L2
+	int inclusion;		// for the LLC, how the whole hierarchy relates, INCLUSION_*
+	int sharers;		// for the LLC, how many cores' L1s and L2s are above it
+	victim_buffer *victims;	// for the LLC, a victim buffer below it (victim.h), or NULL
+	write_buffer *write_buf;	// for the LLC, a write-combining buffer above it (writebuf.h), or NULL
+	miss_profiler *profiler;	// where misses and evictions are charged (missprof.h), or NULL
+	set_telemetry *telemetry;	// per-set counts for some sets (telemetry.h), or NULL
+	xorshift random;	// victims for the random policy
 	set	*sets;
+	block	*blocks;	// every set's, set i's from i * assoc
 	long long int counts[DAN_MAX];
+	cache_stats stats;
 
 	CACHE_REPLACEMENT_STATE *repl;
+	arena	*mem;		// where the sets, blocks and repl live
+	bool	owns_mem;	// init_cache made mem, and free_cache deletes it
 
 	cache (void) {
 		misses = 0;
 		accesses = 0;
 		index_mask = 0;
 		invalidations = 0;
+		prefetch_hits = 0;
+		way_predicted = way_mispredicted = 0;
+		last_victim = 0;
+		back_invalidations = 0;
+		back_invalidations_dirty = 0;
+		writeback_clean = false;
+		inclusion = INCLUSION_EXCLUSIVE;
+		sharers = 1;
+		victims = NULL;
+		write_buf = NULL;
+		profiler = NULL;
+		telemetry = NULL;
+		index_fn = INDEX_MODULO;
+		skew_groups = 1;
+		group_ways = 0;
+		sets = NULL;
+		blocks = NULL;
 		repl = NULL;
+		mem = NULL;
+		owns_mem = false;
 	}
+
+	~cache (void);
 };
 
-void init_cache (cache *c, int nsets, int assoc, int blocksize, int policy, int set_shift);
-bool cache_access (cache *c, unsigned long long int address, unsigned long long int, unsigned int, int op, unsigned int core);
-unsigned int memory_access (cache *l1, cache *l2, cache *l3, unsigned long long int address, unsigned long long int, unsigned int, int op, unsigned int);
+class prefetcher;
+
+// an address decoded for one cache. with a set shift the tag is the block
+// address without the index bits, wherever they were, so the address can
+// always be put back together from the tag and set; the sampler and the
+// caches below need that for victims. in a skewed cache set is the first
+// group's set, and index the unhashed index bits the other groups' sets
+// come from.
+
+struct cache_ref {
+	unsigned long long int tag;
+	unsigned int set, offset;
+	unsigned int index;
+};
+
+// odd multipliers that make each skew group's hash its own; the first
+// group's is the identity, the same hash as INDEX_XOR
+
+static const unsigned long long int skew_multipliers[SKEW_GROUPS_MAX] = {
+	1ull, 0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull,
+	0x27d4eb2f165667c5ull, 0x85ebca77c2b2ae63ull, 0xff51afd7ed558ccdull, 0xc4ceb9fe1a85ec53ull,
+};
+
+// a tag folded down to index_bits by XOR, after mixing it for a skew group
+
+inline unsigned int cache_hash (const cache *c, unsigned long long int tag, int group) {
+	unsigned long long int t = tag * skew_multipliers[group];
+	unsigned int h = 0;
+	if (!c->index_bits) return 0;
+	for (; t; t >>= c->index_bits) h ^= (unsigned int) t;
+	return h & c->index_mask;
+}
+
+inline void cache_decode (cache *c, unsigned long long int address, cache_ref *r) {
+	unsigned long long int block_addr = address >> c->offset_bits;
+	r->offset = address & (c->blocksize - 1);
+	if (c->index_fn == INDEX_MODULO) {
+		r->set = r->index = (block_addr >> c->set_shift) & c->index_mask;
+		r->tag = ((block_addr >> (c->set_shift + c->index_bits)) << c->set_shift) | (block_addr & ((1ull << c->set_shift) - 1));
+	} else {
+		r->tag = block_addr >> c->index_bits;
+		r->index = block_addr & c->index_mask;
+		r->set = r->index ^ cache_hash (c, r->tag, 0);
+	}
+}
+
+// the set a skew group keeps a decoded address in
+
+inline unsigned int skew_set (const cache *c, const cache_ref *r, int group) {
+	return r->index ^ cache_hash (c, r->tag, group);
+}
+
+// the sets come from mem, or with none from an arena of the cache's own
+void init_cache (cache *c, int nsets, int assoc, int blocksize, int policy, int set_shift, arena *mem = NULL);
+// tear down what init_cache made, giving back the memory if it came from
+// the cache's own arena; deleting the cache does this too
+void free_cache (cache *c);
+// use index function fn (INDEX_*), with groups skew groups for INDEX_SKEW,
+// before the first access. false if c can't: skewing needs the LRU or
+// random policy and groups dividing the associativity
+bool cache_set_index (cache *c, int fn, int groups);
+bool cache_access (cache *c, const cache_ref *r, unsigned long long int address, unsigned long long int, unsigned int, int op, unsigned int core, unsigned long long int *writeback_address, bool do_place, int access_source, bool extract = false);
+// where a block is in its set, or -1; in a skewed cache r->set becomes the
+// set it was found in
+int cache_find (cache *c, cache_ref *r);
+bool cache_probe (cache *c, unsigned long long int address);
+void move_to_mru (block *v, int i);
+void move_to_lru (block *v, int i, int assoc);
+unsigned long long int cache_occupancy (cache *c, bool dirty);
+// cache_access on an address that hasn't been decoded yet
+
+inline bool cache_access (cache *c, unsigned long long int address, unsigned long long int pc, unsigned int size, int op, unsigned int core, unsigned long long int *writeback_address = NULL, bool do_place = true, int access_source = 0) {
+	cache_ref r;
+	cache_decode (c, address, &r);
+	return cache_access (c, &r, address, pc, size, op, core, writeback_address, do_place, access_source);
+}
+
+unsigned int memory_access (cache *l1, cache *l2, cache *l3, unsigned long long int address, unsigned long long int, unsigned int, int op, unsigned int, unsigned long long int *memory_writebacks = NULL, prefetcher *pf = NULL);
+
+// the exclusive hierarchy's memory_access split at the LLC, so the private
+// levels and the LLC can run as separate stages: private_access does the
+// core's L1 and L2 and fills in what the LLC has to do, llc_access does it.
+// private_access then llc_access on the same request is memory_access
+// without a prefetcher.
+
+struct llc_request {
+	unsigned long long int address, pc;
+	unsigned int size, core;
+	int op;
+	bool probe;			// missed in the L1 and L2: look for the block in the LLC
+	unsigned long long int victim;	// an L2 victim to place in the LLC, or 0
+	bool probe_miss;		// set by llc_access: the block wasn't in the LLC either
+};
+
+unsigned int private_access (cache *l1, cache *l2, unsigned long long int address, unsigned long long int pc, unsigned int size, int op, unsigned int core, llc_request *req);
+unsigned int llc_access (cache *l3, llc_request *req, unsigned long long int *memory_writebacks);
+
+// host prefetches for the lines a lookup for address in c's set will read
+void cache_prefetch_set (cache *c, unsigned long long int address);
+
+// issue host prefetches for the sets memory_access will look at for this
+// address, so the simulator can start on a record before it gets to it.
+// it changes no state, so results are the same with or without it
+
+void memory_prefetch (cache *l1, cache *l2, cache *l3, unsigned long long int address, unsigned int core);
@@ -0,0 +1,131 @@
+// a simple DRAM model: channels, banks, row buffers and write queues
+
+#include <stdio.h>
+#include <string.h>
+#include "dram.h"
+
+using namespace std;
+
+dram::dram (void) {
+	configure (2, 8, 48, 16);
+}
+
+void dram::configure (int c, int b, int high, int low) {
+	nchannels = c < 1 ? 1 : c > DRAM_MAX_CHANNELS ? DRAM_MAX_CHANNELS : c;
+	nbanks = b < 1 ? 1 : b > DRAM_MAX_BANKS ? DRAM_MAX_BANKS : b;
+	wq_high = high < 1 ? 1 : high;
+	wq_low = low < 0 ? 0 : (unsigned int) low >= wq_high ? wq_high - 1 : low;
+	for (int i=0; i<DRAM_MAX_CHANNELS; i++) {
+		channels[i].bus_free = 0;
+		channels[i].writeq.clear ();
+		for (int j=0; j<DRAM_MAX_BANKS; j++) {
+			channels[i].banks[j].open_row = -1;
+			channels[i].banks[j].busy_until = 0;
+		}
+	}
+	memset (&stats, 0, sizeof (stats));
+}
+
+// consecutive blocks interleave across channels, then fill a row, then
+// move to the next bank
+
+void dram::map (unsigned long long int block, int *channel, int *bank, long long int *row) {
+	*channel = block % nchannels;
+	block /= nchannels;
+	block /= DRAM_ROW_BLOCKS;
+	*bank = block % nbanks;
+	*row = (long long int) (block / nbanks);
+}
+
+// do one access to a bank, open-page policy. returns when its data is off the bus
+
+unsigned long long int dram::service (dram_channel *ch, int b, long long int row, unsigned long long int now, bool *hit, bool *conflict) {
+	dram_bank *bank = &ch->banks[b];
+	unsigned long long int start = now > bank->busy_until ? now : bank->busy_until;
+	unsigned long long int t;
+	*hit = bank->open_row == row;
+	*conflict = !*hit && bank->open_row != -1;
+	if (*hit) t = DRAM_T_CAS;
+	else if (*conflict) t = DRAM_T_RP + DRAM_T_RCD + DRAM_T_CAS;
+	else t = DRAM_T_RCD + DRAM_T_CAS;
+	bank->open_row = row;
+	bank->busy_until = start + t;
+	unsigned long long int data = start + t > ch->bus_free ? start + t : ch->bus_free;
+	ch->bus_free = data + DRAM_T_BURST;
+	return data + DRAM_T_BURST;
+}
+
+// write the queue out down to the low watermark. the banks and the bus
+// stay busy with it, which is what later reads will wait behind.
+
+void dram::drain (dram_channel *ch, unsigned long long int now) {
+	stats.drains++;
+	while (ch->writeq.size () > wq_low) {
+		unsigned long long int block = ch->writeq.front ();
+		ch->writeq.pop_front ();
+		int c, b;
+		long long int row;
+		bool hit, conflict;
+		map (block, &c, &b, &row);
+		service (ch, b, row, now, &hit, &conflict);
+		if (hit) stats.write_row_hits++;
+		if (conflict) stats.write_conflicts++;
+	}
+}
+
+unsigned long long int dram::read (unsigned long long int address, unsigned long long int now) {
+	unsigned long long int block = address >> 6;
+	int c, b;
+	long long int row;
+	map (block, &c, &b, &row);
+	dram_channel *ch = &channels[c];
+	stats.reads++;
+	if (now > stats.last_cycle) stats.last_cycle = now;
+
+	// the newest copy might still be waiting to be written
+
+	for (size_t i=0; i<ch->writeq.size(); i++) {
+		if (ch->writeq[i] == block) {
+			stats.forwarded++;
+			stats.read_latency += DRAM_T_CTRL;
+			return DRAM_T_CTRL;
+		}
+	}
+	bool hit, conflict;
+	unsigned long long int done = service (ch, b, row, now + DRAM_T_CTRL / 2, &hit, &conflict) + DRAM_T_CTRL / 2;
+	if (hit) stats.read_row_hits++;
+	if (conflict) stats.read_conflicts++;
+	stats.read_latency += done - now;
+	return done - now;
+}
+
+void dram::write (unsigned long long int address, unsigned long long int now) {
+	unsigned long long int block = address >> 6;
+	int c, b;
+	long long int row;
+	map (block, &c, &b, &row);
+	dram_channel *ch = &channels[c];
+	stats.writes++;
+	if (now > stats.last_cycle) stats.last_cycle = now;
+
+	// a second write to a queued block just updates it
+
+	for (size_t i=0; i<ch->writeq.size(); i++) if (ch->writeq[i] == block) return;
+	ch->writeq.push_back (block);
+	if (ch->writeq.size () >= wq_high) drain (ch, now);
+}
+
+void dram::report (FILE *f, const dram_stats *since, unsigned long long int cycles) {
+	unsigned long long int reads = stats.reads - since->reads, writes = stats.writes - since->writes;
+	unsigned long long int rhits = stats.read_row_hits - since->read_row_hits, whits = stats.write_row_hits - since->write_row_hits;
+	unsigned long long int fwd = stats.forwarded - since->forwarded;
+	fprintf (f, "DRAM %d channels, %d banks: %lld reads (%lld from write queue), %lld writes, %lld write drains\n",
+		nchannels, nbanks, reads, fwd, writes, stats.drains - since->drains);
+	fprintf (f, "DRAM row hit rate: reads %0.4f writes %0.4f; conflicts: reads %lld writes %lld\n",
+		reads - fwd ? (double) rhits / (reads - fwd) : 0.0, writes ? (double) whits / writes : 0.0,
+		stats.read_conflicts - since->read_conflicts, stats.write_conflicts - since->write_conflicts);
+	fprintf (f, "DRAM average read latency: %0.1f cycles\n",
+		reads ? (double) (stats.read_latency - since->read_latency) / reads : 0.0);
+	if (cycles) fprintf (f, "DRAM bandwidth: read %0.4f write %0.4f bytes/cycle\n",
+		64.0 * reads / cycles, 64.0 * writes / cycles);
+}
@@ -0,0 +1,85 @@
+#ifndef __DRAM_H
+#define __DRAM_H
+
+// a simple DRAM stand-in so memory traffic costs time. it sees the blocks
+// the hierarchy reads from memory and the dirty blocks the LLC writes back,
+// arriving at the requesting core's estimated clock (instructions times
+// the base CPI plus the interval model's stalls so far, see
+// simulator::clock_at, which also orders the cores) rather than the
+// trace's cycle numbers, and models
+//
+//	channels, each with its own data bus and banks
+//	an open-page row buffer per bank: row hits, empty rows, conflicts
+//	a write queue per channel; writes wait there until it reaches the
+//	high watermark, then drain down to the low watermark. reads go
+//	first otherwise, and a read that finds its block in the queue is
+//	served from it
+//
+// read latencies, queueing included, feed the interval timing model.
+// enable with DAN_DRAM=1; DAN_DRAM_CHANNELS (2), DAN_DRAM_BANKS (8),
+// DAN_DRAM_WQ_HIGH (48) and DAN_DRAM_WQ_LOW (16) set the organization.
+// all times are in core cycles.
+
+#include <stdio.h>
+#include <deque>
+
+#define DRAM_MAX_CHANNELS	8
+#define DRAM_MAX_BANKS		32
+#define DRAM_ROW_BLOCKS		128	// 8KB rows of 64-byte blocks
+
+#define DRAM_T_CTRL		60	// on-chip interconnect and controller
+#define DRAM_T_CAS		44	// column access, ~14ns at 3.2GHz
+#define DRAM_T_RCD		44	// activate
+#define DRAM_T_RP		44	// precharge
+#define DRAM_T_BURST		11	// one 64-byte transfer on the bus
+
+struct dram_bank {
+	long long int open_row;			// -1 if closed
+	unsigned long long int busy_until;
+};
+
+struct dram_channel {
+	dram_bank banks[DRAM_MAX_BANKS];
+	unsigned long long int bus_free;
+	std::deque<unsigned long long int> writeq;	// block addresses
+};
+
+struct dram_stats {
+	unsigned long long int reads, writes;
+	unsigned long long int read_row_hits, write_row_hits;
+	unsigned long long int read_conflicts, write_conflicts;
+	unsigned long long int read_latency;	// summed over reads
+	unsigned long long int forwarded;	// reads served from a write queue
+	unsigned long long int drains;
+	unsigned long long int last_cycle;
+};
+
+class dram {
+	dram_channel channels[DRAM_MAX_CHANNELS];
+	int nchannels, nbanks;
+	unsigned int wq_high, wq_low;
+
+	void map (unsigned long long int block, int *channel, int *bank, long long int *row);
+	unsigned long long int service (dram_channel *ch, int bank, long long int row, unsigned long long int now, bool *hit, bool *conflict);
+	void drain (dram_channel *ch, unsigned long long int now);
+
+public:
+	dram_stats stats;
+
+	dram (void);
+
+	// read from the environment; call before any traffic
+	void configure (int channels, int banks, int high, int low);
+
+	// a block read from memory at cycle now; returns its latency
+	unsigned long long int read (unsigned long long int address, unsigned long long int now);
+
+	// a dirty block written back to memory at cycle now
+	void write (unsigned long long int address, unsigned long long int now);
+
+	// report the traffic since a snapshot of the statistics over the
+	// given number of cycles
+	void report (FILE *f, const dram_stats *since, unsigned long long int cycles);
+};
+
+#endif
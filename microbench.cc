@@ -0,0 +1,251 @@
+// microbench: time the simulator's primitives in isolation on synthetic,
+// deterministic access streams, so performance work on the core doesn't
+// need real traces.
+//
+// usage: microbench [-n ops] [-r repeats] [-f filter] [-w baseline] [-b baseline [-t percent]]
+//
+// every benchmark is run -r times (5 by default) over -n operations
+// (1M by default) and reported as mean and standard deviation in ns/op.
+// -f only runs benchmarks whose name contains the filter. -w writes the
+// results to a baseline file; -b compares against one and exits with
+// status 1 if any benchmark got slower by more than -t percent (10).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "utils.h"
+#include "replacement_state.h"
+#include "stats.h"
+#include "cache.h"
+
+// xorshift64*, so every run sees the same streams
+
+struct synth_access {
+	unsigned long long int address;
+	int op;
+};
+
+// the synthetic streams; footprints are in 64-byte blocks
+
+enum { STREAM_SEQ, STREAM_STRIDE, STREAM_RANDOM, STREAM_HOT, STREAM_MAX };
+static const char *stream_names[STREAM_MAX] = { "seq", "stride", "random", "hot" };
+
+static void make_stream (vector<synth_access> &v, int kind, double write_fraction, int n) {
+	xorshift r (kind * 1000 + (int) (write_fraction * 100) + 1);
+	const unsigned long long int footprint = 1 << 20;	// 64MB
+	const unsigned long long int hot = 1 << 10;		// 64KB
+	v.resize (n);
+	for (int i=0; i<n; i++) {
+		unsigned long long int b;
+		switch (kind) {
+		case STREAM_SEQ: b = i % footprint; break;
+		case STREAM_STRIDE: b = (i * 67ull) % footprint; break;	// 4KB+ stride, defeats the set index
+		case STREAM_RANDOM: b = r.next () % footprint; break;
+		default: b = (r.next () % 10) ? r.next () % hot : r.next () % footprint; break;
+		}
+		v[i].address = b << 6;
+		v[i].op = ((r.next () % 1000) < write_fraction * 1000) ? DAN_WRITE : DAN_DREAD;
+	}
+}
+
+struct geometry {
+	const char *name;
+	int nsets, assoc;
+};
+
+static geometry geometries[] = {
+	{ "L1", 256, 4 },
+	{ "L2", 512, 8 },
+	{ "LLC", 4096, 16 },
+	{ NULL, 0, 0 } };
+
+static const char *policy_names[] = { "lru", "random", "rwp" };
+
+static int nops = 1 << 20, repeats = 5;
+static const char *filter = NULL;
+static map<string, pair<double,double> > results;
+
+static double now (void) {
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// run body() repeats times and record mean and standard deviation of ns/op.
+// setup() runs before each repetition, outside the timed region.
+
+template <class S, class B>
+static void bench (const string &name, S setup, B body) {
+	if (filter && !strstr (name.c_str (), filter)) return;
+	vector<double> t;
+	for (int r=0; r<repeats; r++) {
+		setup ();
+		double start = now ();
+		body ();
+		t.push_back ((now () - start) / nops);
+	}
+	double mean = 0, var = 0;
+	for (size_t i=0; i<t.size(); i++) mean += t[i];
+	mean /= t.size ();
+	for (size_t i=0; i<t.size(); i++) var += (t[i] - mean) * (t[i] - mean);
+	double sd = t.size () > 1 ? sqrt (var / (t.size () - 1)) : 0;
+	results[name] = make_pair (mean, sd);
+	printf ("%-36s %10.2f ns/op %8.2f sd\n", name.c_str (), mean, sd);
+	fflush (stdout);
+}
+
+static volatile long long int sink;
+
+int main (int argc, char *argv[]) {
+	const char *write_name = NULL, *base_name = NULL;
+	double threshold = 10;
+	int c;
+	while ((c = getopt (argc, argv, "n:r:f:w:b:t:")) != -1) {
+		switch (c) {
+		case 'n': nops = atoi (optarg); break;
+		case 'r': repeats = atoi (optarg); break;
+		case 'f': filter = optarg; break;
+		case 'w': write_name = optarg; break;
+		case 'b': base_name = optarg; break;
+		case 't': threshold = atof (optarg); break;
+		default:
+			fprintf (stderr, "usage: %s [-n ops] [-r repeats] [-f filter] [-w baseline] [-b baseline [-t percent]]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (nops < 1) nops = 1;
+	if (repeats < 1) repeats = 1;
+
+	// the streams
+
+	double mixes[] = { 0.0, 0.3 };
+	vector<synth_access> streams[STREAM_MAX][2];
+	for (int k=0; k<STREAM_MAX; k++)
+		for (int m=0; m<2; m++) make_stream (streams[k][m], k, mixes[m], nops);
+
+	xorshift r (12345);
+	vector<unsigned int> sets (nops), ways (nops);
+
+	for (int g=0; geometries[g].name; g++) {
+		geometry *geo = &geometries[g];
+		for (int p=0; p<3; p++) {
+			string prefix = string (geo->name) + "." + policy_names[p] + ".";
+
+			// whole cache_access calls on each stream
+
+			for (int k=0; k<STREAM_MAX; k++) {
+				for (int m=0; m<2; m++) {
+					vector<synth_access> &s = streams[k][m];
+					cache *ca = NULL;
+					bench (prefix + "access." + stream_names[k] + (m ? ".rw" : ".ro"),
+						[&] () {
+							// a fresh cache, warmed with one pass over the stream
+							delete ca;
+							ca = new cache;
+							init_cache (ca, geo->nsets, geo->assoc, 64, p, 0);
+							for (int i=0; i<nops; i++) cache_access (ca, s[i].address, 0, 8, s[i].op, 0);
+						},
+						[&] () {
+							long long int misses = 0;
+							for (int i=0; i<nops; i++) misses += cache_access (ca, s[i].address, 0x400000 + (i & 255) * 4, 8, s[i].op, 0);
+							sink = misses;
+						});
+					delete ca;
+				}
+			}
+
+			// victim selection and replacement updates on the policy's state alone
+
+			for (int i=0; i<nops; i++) {
+				sets[i] = r.next () % geo->nsets;
+				ways[i] = r.next () % geo->assoc;
+			}
+			CACHE_REPLACEMENT_STATE *repl = NULL;
+			bench (prefix + "victim",
+				[&] () {
+					delete repl;
+					repl = new CACHE_REPLACEMENT_STATE (geo->nsets, geo->assoc, p);
+					LINE_STATE ls;
+					for (int i=0; i<nops; i++) {
+						ls.tag = i + 1;
+						repl->UpdateReplacementState (sets[i], ways[i], &ls, 0, 0, (i & 3) ? ACCESS_LOAD : ACCESS_STORE, i & 1, 0);
+					}
+				},
+				[&] () {
+					long long int x = 0;
+					for (int i=0; i<nops; i++) x += repl->GetVictimInSet (0, sets[i], NULL, geo->assoc, 0, 0, ACCESS_LOAD, 0);
+					sink = x;
+				});
+			bench (prefix + "update",
+				[&] () {
+					delete repl;
+					repl = new CACHE_REPLACEMENT_STATE (geo->nsets, geo->assoc, p);
+				},
+				[&] () {
+					LINE_STATE ls;
+					for (int i=0; i<nops; i++) {
+						ls.tag = i + 1;
+						repl->UpdateReplacementState (sets[i], ways[i], &ls, 0, 0, (i & 3) ? ACCESS_LOAD : ACCESS_STORE, i & 1, 0);
+					}
+				});
+			delete repl;
+		}
+
+		// move_to_mru doesn't depend on the policy
+
+		block v[MAX_ASSOC];
+		bench (string (geo->name) + ".move_to_mru",
+			[&] () {
+				for (int i=0; i<geo->assoc; i++) v[i].tag = i;
+			},
+			[&] () {
+				for (int i=0; i<nops; i++) move_to_mru (v, ways[i]);
+				sink = v[0].tag;
+			});
+	}
+
+	if (write_name) {
+		FILE *f = fopen (write_name, "w");
+		if (!f) {
+			perror (write_name);
+			return 1;
+		}
+		for (map<string, pair<double,double> >::iterator i = results.begin (); i != results.end (); i++)
+			fprintf (f, "%s %0.4f %0.4f\n", i->first.c_str (), i->second.first, i->second.second);
+		fclose (f);
+	}
+
+	// compare against a baseline
+
+	int regressions = 0;
+	if (base_name) {
+		FILE *f = fopen (base_name, "r");
+		if (!f) {
+			perror (base_name);
+			return 1;
+		}
+		char name[1000];
+		double mean, sd;
+		printf ("\n%-36s %10s %10s %8s\n", "benchmark", "baseline", "now", "change");
+		while (fscanf (f, "%999s %lf %lf", name, &mean, &sd) == 3) {
+			map<string, pair<double,double> >::iterator i = results.find (name);
+			if (i == results.end () || mean <= 0) continue;
+			double change = 100.0 * (i->second.first - mean) / mean;
+			bool slower = change > threshold;
+			if (slower) regressions++;
+			printf ("%-36s %10.2f %10.2f %+7.1f%%%s\n", name, mean, i->second.first, change, slower ? "  REGRESSION" : "");
+		}
+		fclose (f);
+		printf ("%d regression%s beyond %0.1f%%\n", regressions, regressions == 1 ? "" : "s", threshold);
+	}
+	return regressions ? 1 : 0;
+}
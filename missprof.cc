@@ -0,0 +1,196 @@
+// LLC miss attribution by PC and address region; see missprof.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "missprof.h"
+
+using namespace std;
+
+static inline unsigned int mp_hash (unsigned long long int key, unsigned int capacity) {
+	return (unsigned int) ((key * 0x9e3779b97f4a7c15ull) >> 32) & (capacity - 1);
+}
+
+mp_table::mp_table (void) {
+	capacity = MP_INITIAL_CAPACITY;
+	used = 0;
+	entries = (mp_entry *) calloc (capacity, sizeof (mp_entry));
+}
+
+mp_table::~mp_table (void) {
+	free (entries);
+}
+
+void mp_table::clear (void) {
+	memset (entries, 0, capacity * sizeof (mp_entry));
+	used = 0;
+}
+
+// the entry for key, made if it isn't there yet
+
+mp_entry *mp_table::lookup (unsigned long long int key) {
+	key++;
+	unsigned int i = mp_hash (key, capacity);
+	while (entries[i].key) {
+		if (entries[i].key == key) return &entries[i];
+		i = (i + 1) & (capacity - 1);
+	}
+	if (2 * (used + 1) > capacity) {
+		grow ();
+		return lookup (key - 1);
+	}
+	used++;
+	entries[i].key = key;
+	return &entries[i];
+}
+
+void mp_table::grow (void) {
+	mp_entry *old = entries;
+	unsigned int n = capacity;
+	capacity *= 2;
+	entries = (mp_entry *) calloc (capacity, sizeof (mp_entry));
+	for (unsigned int k=0; k<n; k++) {
+		if (!old[k].key) continue;
+		unsigned int i = mp_hash (old[k].key, capacity);
+		while (entries[i].key) i = (i + 1) & (capacity - 1);
+		entries[i] = old[k];
+	}
+	free (old);
+}
+
+mp_lifetimes::mp_lifetimes (void) {
+	capacity = MP_INITIAL_CAPACITY;
+	used = 0;
+	entries = (mp_lifetime *) calloc (capacity, sizeof (mp_lifetime));
+}
+
+mp_lifetimes::~mp_lifetimes (void) {
+	free (entries);
+}
+
+mp_lifetime *mp_lifetimes::find (unsigned long long int block) {
+	unsigned long long int key = block + 1;
+	unsigned int i = mp_hash (key, capacity);
+	while (entries[i].key) {
+		if (entries[i].key == key) return &entries[i];
+		i = (i + 1) & (capacity - 1);
+	}
+	return NULL;
+}
+
+mp_lifetime *mp_lifetimes::lookup (unsigned long long int block) {
+	mp_lifetime *l = find (block);
+	if (l) return l;
+	if (2 * (used + 1) > capacity) grow ();
+	unsigned long long int key = block + 1;
+	unsigned int i = mp_hash (key, capacity);
+	while (entries[i].key) i = (i + 1) & (capacity - 1);
+	used++;
+	entries[i].key = key;
+	return &entries[i];
+}
+
+// backward shift: walk the run after the hole and move back each entry
+// whose home isn't between the hole and where it sits, so every entry
+// stays reachable from its home without tombstones
+
+void mp_lifetimes::erase (mp_lifetime *l) {
+	unsigned int mask = capacity - 1;
+	unsigned int hole = (unsigned int) (l - entries);
+	unsigned int i = hole;
+	for (;;) {
+		i = (i + 1) & mask;
+		if (!entries[i].key) break;
+		unsigned int home = mp_hash (entries[i].key, capacity);
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			entries[hole] = entries[i];
+			hole = i;
+		}
+	}
+	entries[hole].key = 0;
+	used--;
+}
+
+void mp_lifetimes::grow (void) {
+	mp_lifetime *old = entries;
+	unsigned int n = capacity;
+	capacity *= 2;
+	entries = (mp_lifetime *) calloc (capacity, sizeof (mp_lifetime));
+	for (unsigned int k=0; k<n; k++) {
+		if (!old[k].key) continue;
+		unsigned int i = mp_hash (old[k].key, capacity);
+		while (entries[i].key) i = (i + 1) & (capacity - 1);
+		entries[i] = old[k];
+	}
+	free (old);
+}
+
+miss_profiler::miss_profiler (int bits, int n, bool excl) {
+	region_bits = bits;
+	top = n;
+	exclusive = excl;
+}
+
+void miss_profiler::clear (void) {
+	pcs.clear ();
+	regions.clear ();
+}
+
+// the n entries with the most of one event, and their share of its total.
+// keys are shifted back up to addresses
+
+void miss_profiler::report_top (FILE *f, const char *what, mp_table *t, int shift, int event, int n) {
+	static const char *names[MP_EVENTS] = { "misses", "fills", "dead", "dirty", "bypasses" };
+	vector<mp_entry *> v;
+	unsigned long long int total = 0;
+	for (unsigned int i=0; i<t->capacity; i++) if (t->entries[i].key && t->entries[i].counts[event]) {
+		v.push_back (&t->entries[i]);
+		total += t->entries[i].counts[event];
+	}
+	if (n > (int) v.size ()) n = v.size ();
+	partial_sort (v.begin (), v.begin () + n, v.end (), [event] (const mp_entry *a, const mp_entry *b) { return a->counts[event] > b->counts[event]; });
+	fprintf (f, "top %d %s by LLC %s (%lld in all, %d %s):\n", n, what, names[event], total, (int) v.size (), what);
+	unsigned long long int sum = 0;
+	for (int k=0; k<n; k++) {
+		mp_entry *e = v[k];
+		sum += e->counts[event];
+		fprintf (f, "  0x%llx: %0.2f%% (%0.2f%% cumulative) misses %lld fills %lld dead %lld dirty %lld bypasses %lld\n",
+			(e->key - 1) << shift,
+			100.0 * e->counts[event] / total, 100.0 * sum / total,
+			e->counts[MP_MISSES], e->counts[MP_FILLS], e->counts[MP_DEAD], e->counts[MP_DIRTY], e->counts[MP_BYPASSES]);
+	}
+}
+
+void miss_profiler::report (FILE *f) {
+	if (exclusive) fprintf (f, "exclusive hierarchy: fills are reads from memory, dead fills left the LLC without it sending them back up, dirty evictions aren't known\n");
+	report_top (f, "PCs", &pcs, 0, MP_MISSES, top);
+	report_top (f, "PCs", &pcs, 0, MP_DEAD, top);
+	report_top (f, "regions", &regions, region_bits, MP_MISSES, top);
+	report_top (f, "regions", &regions, region_bits, MP_DEAD, top);
+}
+
+static void dump_table (FILE *f, mp_table *t) {
+	for (unsigned int i=0; i<t->capacity; i++) if (t->entries[i].key) {
+		unsigned long long int key = t->entries[i].key - 1;
+		fwrite (&key, sizeof (key), 1, f);
+		fwrite (t->entries[i].counts, sizeof (t->entries[i].counts), 1, f);
+	}
+}
+
+bool miss_profiler::dump (const char *filename) {
+	FILE *f = fopen (filename, "wb");
+	if (!f) {
+		perror (filename);
+		return false;
+	}
+	unsigned int header[2] = { (unsigned int) region_bits, MP_EVENTS };
+	unsigned long long int sizes[2] = { pcs.used, regions.used };
+	fwrite ("MISSPRF1", 8, 1, f);
+	fwrite (header, sizeof (header), 1, f);
+	fwrite (sizes, sizeof (sizes), 1, f);
+	dump_table (f, &pcs);
+	dump_table (f, &regions);
+	return fclose (f) == 0;
+}
@@ -0,0 +1,157 @@
+#ifndef __MISSPROF_H
+#define __MISSPROF_H
+
+// who is responsible for the LLC's misses. with DAN_MISS_PROFILE=1 the
+// LLC charges each of these events to a PC and to the address region the
+// block is in (2^DAN_MISS_PROFILE_REGION bytes, 4KB by default):
+//
+//	misses		a demand or prefetch access missed; the accessing PC
+//	fills		a block was placed; the filling PC
+//	dead		a block was evicted without a hit since it was
+//			placed; the PC that filled it
+//	dirty		a dirty block was evicted; the PC that filled it
+//	bypasses	the policy declined to place a block; the accessing PC
+//
+// in the exclusive hierarchy the LLC holds only L2 victims, every one of
+// them written back, and a hit takes the block out, so the events above
+// would say nothing: every eviction would be dead and dirty, charged to
+// whichever access pushed the block out of the L2. there a block's
+// lifetime runs from being read from memory to being evicted from the
+// LLC instead, and the profiler keeps each one on the side:
+//
+//	fills		a block was read from memory; the PC that read it
+//	dead		a block was evicted from the LLC without the LLC (or
+//			its write or victim buffer) having sent it back up
+//			since it was read; the PC that read it
+//	dirty		not counted: the exclusive L1 and L2 write every
+//			victim back, so whether it was written is lost
+//
+// evictions of blocks whose lifetime isn't known (ones that came back from
+// the victim buffer) aren't charged.
+//
+// counting starts at the end of warming. the run ends with the top
+// DAN_MISS_PROFILE_TOP (20) PCs and regions by misses and by dead fills,
+// and with DAN_MISS_PROFILE_DUMP=file every entry is written there too:
+//
+//	char magic[8]		"MISSPRF1"
+//	unsigned int region_bits, events	events is MP_EVENTS
+//	unsigned long long int npcs, nregions
+//	npcs then nregions of { unsigned long long int key, counts[events] }
+//
+// all little-endian as the host writes them. the tables are open
+// addressing with linear probing, and grow by doubling at half full; the
+// lifetimes table deletes by shifting the entries after a hole back, so
+// it needs no tombstones.
+
+#include <stdio.h>
+
+#define MP_MISSES	0
+#define MP_FILLS	1
+#define MP_DEAD		2
+#define MP_DIRTY	3
+#define MP_BYPASSES	4
+#define MP_EVENTS	5
+
+#define MP_INITIAL_CAPACITY	4096
+
+struct mp_entry {
+	unsigned long long int key;	// one more than the PC or region; 0 is a free entry
+	unsigned long long int counts[MP_EVENTS];
+};
+
+struct mp_table {
+	mp_entry *entries;
+	unsigned int capacity, used;	// capacity is a power of two
+
+	mp_table (void);
+	~mp_table (void);
+	void clear (void);
+	mp_entry *lookup (unsigned long long int key);
+
+private:
+	void grow (void);
+};
+
+// a block's lifetime in the exclusive hierarchy
+struct mp_lifetime {
+	unsigned long long int key;	// one more than the block address; 0 is a free entry
+	unsigned long long int pc;	// read it from memory
+	bool reused;			// the LLC has sent it back up since
+};
+
+struct mp_lifetimes {
+	mp_lifetime *entries;
+	unsigned int capacity, used;	// capacity is a power of two
+
+	mp_lifetimes (void);
+	~mp_lifetimes (void);
+	mp_lifetime *lookup (unsigned long long int block);	// made if it isn't there
+	mp_lifetime *find (unsigned long long int block);	// NULL if it isn't there
+	void erase (mp_lifetime *l);
+
+private:
+	void grow (void);
+};
+
+class miss_profiler {
+	mp_table pcs, regions;
+	mp_lifetimes lifetimes;		// by block address, in the exclusive hierarchy
+
+	void count (unsigned long long int pc, unsigned long long int address, int event) {
+		pcs.lookup (pc)->counts[event]++;
+		regions.lookup (address >> region_bits)->counts[event]++;
+	}
+
+	void report_top (FILE *f, const char *what, mp_table *t, int shift, int event, int n);
+
+public:
+	int region_bits, top;
+	bool exclusive;		// charge by lifetimes, as above
+
+	miss_profiler (int region_bits, int top, bool exclusive);
+
+	void miss (unsigned long long int pc, unsigned long long int address) { count (pc, address, MP_MISSES); }
+	void bypass (unsigned long long int pc, unsigned long long int address) { count (pc, address, MP_BYPASSES); }
+
+	// a block placed in the LLC; in the exclusive hierarchy that's a
+	// writeback, not a fill
+	void fill (unsigned long long int pc, unsigned long long int address) {
+		if (!exclusive) count (pc, address, MP_FILLS);
+	}
+
+	// with exclusion, a block read from memory, and one the LLC sent up
+	void read (unsigned long long int pc, unsigned long long int block) {
+		count (pc, block, MP_FILLS);
+		mp_lifetime *l = lifetimes.lookup (block);
+		l->pc = pc;
+		l->reused = false;
+	}
+	void supplied (unsigned long long int block) {
+		mp_lifetime *l = lifetimes.find (block);
+		if (l) l->reused = true;
+	}
+
+	// a block evicted from the LLC; pc filled it there, and dead and
+	// dirty are what the LLC knows of it
+	void evicted (unsigned long long int pc, unsigned long long int address, bool dead, bool dirty) {
+		if (exclusive) {
+			mp_lifetime *l = lifetimes.find (address);
+			if (!l) return;
+			if (!l->reused) count (l->pc, address, MP_DEAD);
+			lifetimes.erase (l);
+			return;
+		}
+		if (dead) count (pc, address, MP_DEAD);
+		if (dirty) count (pc, address, MP_DIRTY);
+	}
+
+	// forget the counts so far, at the end of warming; lifetimes go on
+	void clear (void);
+
+	void report (FILE *f);
+
+	// the binary dump described above; false if it couldn't be written
+	bool dump (const char *filename);
+};
+
+#endif
@@ -0,0 +1,154 @@
+// mix: run multi-programmed mixes on the shared LLC and report how each
+// core fares relative to running alone.
+//
+// usage: mix [-n nmixes] [-k cores] [-s seed] [-l benchmark-list] [mix ...]
+//
+// each mix on the command line is a comma-separated list of benchmark
+// names, e.g. 403.gcc-16B,470.lbm-1274B. -n generates that many random
+// mixes of -k distinct benchmarks from the list (benchmarks.txt by
+// default). the policy under test comes from DAN_POLICY as usual;
+// standalone IPCs are measured with DAN_ALONE_POLICY (default 0, LRU)
+// and kept in the results cache shared with suite, so they are only
+// simulated once per trace and configuration.
+//
+// for each mix we report
+//	weighted speedup	sum of IPC_shared / IPC_alone
+//	harmonic speedup	ncores / sum of IPC_alone / IPC_shared
+//	max slowdown		max of IPC_alone / IPC_shared
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "runner.h"
+
+using namespace std;
+
+static vector<string> split_mix (const char *s) {
+	vector<string> v;
+	string cur;
+	for (; *s; s++) {
+		if (*s == ',') {
+			if (cur.size()) v.push_back (cur);
+			cur.clear ();
+		} else cur += *s;
+	}
+	if (cur.size()) v.push_back (cur);
+	return v;
+}
+
+int main (int argc, char *argv[]) {
+	int nrandom = 0, ncores = 4, seed = 1;
+	const char *listname = "benchmarks.txt";
+	int c;
+	while ((c = getopt (argc, argv, "n:k:s:l:")) != -1) {
+		switch (c) {
+		case 'n': nrandom = atoi (optarg); break;
+		case 'k': ncores = atoi (optarg); break;
+		case 's': seed = atoi (optarg); break;
+		case 'l': listname = optarg; break;
+		default:
+			fprintf (stderr, "usage: %s [-n nmixes] [-k cores] [-s seed] [-l benchmark-list] [mix ...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	// collect the mixes
+
+	vector<vector<string> > mixes;
+	for (int i=optind; i<argc; i++) mixes.push_back (split_mix (argv[i]));
+	if (nrandom) {
+		vector<string> bench = read_benchmark_list (listname);
+		if ((int) bench.size () < ncores || ncores < 1 || ncores > RUNNER_MAX_CORES) {
+			fprintf (stderr, "can't make %d-core mixes from %d benchmarks\n", ncores, (int) bench.size ());
+			return 1;
+		}
+		srand (seed);
+		for (int i=0; i<nrandom; i++) {
+			vector<string> pool = bench, mix;
+			for (int j=0; j<ncores; j++) {
+				int k = rand () % pool.size ();
+				mix.push_back (pool[k]);
+				pool.erase (pool.begin () + k);
+			}
+			mixes.push_back (mix);
+		}
+	}
+	if (mixes.empty ()) {
+		fprintf (stderr, "no mixes to run\n");
+		return 1;
+	}
+
+	// standalone runs for every trace in a mix, plus the mixes themselves,
+	// all in one parallel batch. the cache takes care of the ones we've
+	// already simulated.
+
+	vector<run_job> jobs;
+	map<string,int> alone;
+	for (size_t i=0; i<mixes.size(); i++) {
+		for (size_t j=0; j<mixes[i].size(); j++) {
+			const string &t = mixes[i][j];
+			if (alone.count (t)) continue;
+			alone[t] = (int) jobs.size ();
+			run_job job;
+			job.traces.push_back (t);
+			job.env.push_back ("DAN_POLICY=" + runner_getenv ("DAN_ALONE_POLICY", "0"));
+			jobs.push_back (job);
+		}
+	}
+	size_t first_mix = jobs.size ();
+	for (size_t i=0; i<mixes.size(); i++) {
+		run_job job;
+		job.traces = mixes[i];
+		jobs.push_back (job);
+	}
+	results_cache cache;
+	run_all (jobs, runner_jobs (), &cache);
+
+	// report
+
+	double sum_ws = 0, sum_hs = 0, worst = 0;
+	int nok = 0;
+	for (size_t i=0; i<mixes.size(); i++) {
+		run_job &j = jobs[first_mix + i];
+		printf ("mix %d:", (int) i);
+		for (size_t k=0; k<mixes[i].size(); k++) printf (" %s", mixes[i][k].c_str ());
+		printf ("\n");
+		if (!j.ok) {
+			printf ("  failed\n");
+			continue;
+		}
+		double ws = 0, inv = 0, slow = 0;
+		bool missing = false;
+		for (size_t k=0; k<mixes[i].size(); k++) {
+			run_job &a = jobs[alone[mixes[i][k]]];
+			double shared = j.result.ipc[k];
+			if (!a.ok || a.result.ipc[0] <= 0 || shared <= 0) {
+				missing = true;
+				continue;
+			}
+			double speedup = shared / a.result.ipc[0];
+			printf ("  core %d: %s shared %0.4f IPC alone %0.4f IPC speedup %0.4f\n",
+				(int) k, mixes[i][k].c_str (), shared, a.result.ipc[0], speedup);
+			ws += speedup;
+			inv += 1 / speedup;
+			if (1 / speedup > slow) slow = 1 / speedup;
+		}
+		if (missing) {
+			printf ("  no standalone IPC for some cores\n");
+			continue;
+		}
+		double hs = mixes[i].size () / inv;
+		printf ("  weighted speedup %0.4f harmonic speedup %0.4f max slowdown %0.4f\n", ws, hs, slow);
+		sum_ws += ws;
+		sum_hs += hs;
+		if (slow > worst) worst = slow;
+		nok++;
+	}
+	if (nok) printf ("average over %d mixes: weighted speedup %0.4f harmonic speedup %0.4f max slowdown %0.4f\n",
+		nok, sum_ws / nok, sum_hs / nok, worst);
+	return nok == (int) mixes.size () ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+// typed parameter registry; see params.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "params.h"
+
+static int *int_field (const param *p, void *settings) {
+	return (int *) ((char *) settings + p->offset);
+}
+
+static double *double_field (const param *p, void *settings) {
+	return (double *) ((char *) settings + p->offset);
+}
+
+void params_defaults (const param *table, int n, void *settings) {
+	for (int i=0; i<n; i++) {
+		const param *p = &table[i];
+		if (p->type == PARAM_INT) *int_field (p, settings) = (int) p->def;
+		else *double_field (p, settings) = p->def;
+	}
+}
+
+bool params_parse (const param *p, const char *s, double *x) {
+	char *end;
+	if (p->type == PARAM_INT) *x = strtol (s, &end, 0);
+	else *x = strtod (s, &end);
+	if (end == s || *end || *x < p->min || *x > p->max) {
+		fprintf (stderr, "%s=%s: want %s from %.10g to %.10g\n", p->name, s,
+			p->type == PARAM_INT ? "an integer" : "a number", p->min, p->max);
+		return false;
+	}
+	return true;
+}
+
+bool params_from_env (const param *table, int n, void *settings) {
+	for (int i=0; i<n; i++) {
+		const param *p = &table[i];
+		char *s = getenv (p->name);
+		if (!s) continue;
+		double x;
+		if (!params_parse (p, s, &x)) return false;
+		if (p->type == PARAM_INT) {
+			*int_field (p, settings) = (int) x;
+			fprintf (stderr, "%s=%d\n", p->name, (int) x);
+		} else {
+			*double_field (p, settings) = x;
+			fprintf (stderr, "%s=%g\n", p->name, x);
+		}
+	}
+	return true;
+}
+
+const param *params_find (const param *table, int n, const char *name) {
+	for (int i=0; i<n; i++) if (!strcmp (table[i].name, name)) return &table[i];
+	return NULL;
+}
+
+void params_list (FILE *f, const param *table, int n) {
+	for (int i=0; i<n; i++) {
+		const param *p = &table[i];
+		fprintf (f, "%-28s %-6s %10.10g %10.10g..%-10.10g %s\n", p->name, p->type == PARAM_INT ? "int" : "double",
+			p->def, p->min, p->max, p->doc);
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef __PARAMS_H
+#define __PARAMS_H
+
+// a registry of typed, tunable parameters. each one has the DAN_* name
+// it is read from, a type, a default, a range, a line saying what it
+// does, and the offset of the field it sets in some struct of settings,
+// so one table says both how to read a group of parameters and where they
+// go. reading them echoes each one that is set to stderr, like GET_PARAM,
+// but a value that doesn't parse or is out of range is an error instead
+// of being taken as it comes. "exclusiu -params" lists the registered
+// parameters; the tuner (tune.cc) searches over them by name.
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define PARAM_INT	0
+#define PARAM_DOUBLE	1
+
+struct param {
+	const char *name;
+	int type;		// PARAM_*: the field is an int or a double
+	size_t offset;		// of the field in the settings struct
+	double def, min, max;
+	const char *doc;
+};
+
+// every parameter in the table set to its default
+void params_defaults (const param *table, int n, void *settings);
+
+// the value s gives p in *x; returns false and says why on stderr if it
+// doesn't parse or is out of range
+bool params_parse (const param *p, const char *s, double *x);
+
+// override the defaults with whatever is set in the environment; returns
+// false and says why on stderr if a value is no good
+bool params_from_env (const param *table, int n, void *settings);
+
+// the parameter called name, or NULL
+const param *params_find (const param *table, int n, const char *name);
+
+// one line per parameter: name, type, default, range and doc
+void params_list (FILE *f, const param *table, int n);
+
+#endif
@@ -0,0 +1,93 @@
+// work-stealing thread pool
+
+#include <unistd.h>
+#include "pool.h"
+
+using namespace std;
+
+work_pool::work_pool (int nthreads) {
+	if (nthreads <= 0) nthreads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0) nthreads = 1;
+	pending = 0;
+	next = 0;
+	stopping = false;
+	for (int i=0; i<nthreads; i++) workers.push_back (new worker);
+	for (int i=0; i<nthreads; i++) threads.push_back (thread (&work_pool::run, this, i));
+}
+
+work_pool::~work_pool (void) {
+	wait ();
+	{
+		lock_guard<mutex> g (idle_lock);
+		stopping = true;
+	}
+	idle.notify_all ();
+	for (size_t i=0; i<threads.size(); i++) threads[i].join ();
+	for (size_t i=0; i<workers.size(); i++) delete workers[i];
+}
+
+void work_pool::submit (function<void()> task) {
+	worker *w = workers[next++ % workers.size ()];
+	pending++;
+	{
+		lock_guard<mutex> g (w->lock);
+		w->tasks.push_back (task);
+	}
+	// take idle_lock so a worker can't miss the wakeup between
+	// finding nothing to do and going to sleep
+	lock_guard<mutex> g (idle_lock);
+	idle.notify_all ();
+}
+
+// get a task from our own deque, or steal one from someone else's
+
+bool work_pool::take (int self, function<void()> &task) {
+	int n = (int) workers.size ();
+	{
+		worker *w = workers[self];
+		lock_guard<mutex> g (w->lock);
+		if (!w->tasks.empty ()) {
+			task = w->tasks.back ();
+			w->tasks.pop_back ();
+			return true;
+		}
+	}
+	for (int i=1; i<n; i++) {
+		worker *w = workers[(self + i) % n];
+		lock_guard<mutex> g (w->lock);
+		if (!w->tasks.empty ()) {
+			task = w->tasks.front ();
+			w->tasks.pop_front ();
+			return true;
+		}
+	}
+	return false;
+}
+
+void work_pool::run (int self) {
+	for (;;) {
+		function<void()> task;
+		if (take (self, task)) {
+			task ();
+			if (--pending == 0) {
+				lock_guard<mutex> g (idle_lock);
+				idle.notify_all ();
+			}
+			continue;
+		}
+		unique_lock<mutex> g (idle_lock);
+		if (stopping) return;
+		// re-check under the lock; submit() notifies while holding it
+		bool any = false;
+		for (size_t i=0; i<workers.size() && !any; i++) {
+			lock_guard<mutex> wg (workers[i]->lock);
+			any = !workers[i]->tasks.empty ();
+		}
+		if (!any) idle.wait (g);
+	}
+}
+
+void work_pool::wait (void) {
+	unique_lock<mutex> g (idle_lock);
+	while (pending > 0) idle.wait (g);
+}
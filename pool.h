@@ -0,0 +1,47 @@
+#ifndef __POOL_H
+#define __POOL_H
+
+// a small work-stealing thread pool. each worker has its own deque;
+// it takes work from the back of its own deque and, when that runs dry,
+// steals from the front of the others. tasks submitted from outside are
+// dealt round-robin across the workers.
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <condition_variable>
+
+class work_pool {
+	struct worker {
+		std::mutex lock;
+		std::deque<std::function<void()> > tasks;
+	};
+
+	std::vector<worker *> workers;
+	std::vector<std::thread> threads;
+	std::mutex idle_lock;
+	std::condition_variable idle;
+	std::atomic<int> pending;
+	std::atomic<unsigned int> next;
+	bool stopping;
+
+	bool take (int self, std::function<void()> &task);
+	void run (int self);
+
+public:
+	// nthreads <= 0 means one per online processor
+	work_pool (int nthreads = 0);
+	~work_pool (void);
+
+	int size (void) { return (int) workers.size (); }
+
+	void submit (std::function<void()> task);
+
+	// block until every submitted task has finished
+	void wait (void);
+};
+
+#endif
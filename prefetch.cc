@@ -0,0 +1,168 @@
+// hardware prefetchers: next-line, PC-stride and stream
+
+#include <stdio.h>
+#include <string.h>
+#include "prefetch.h"
+
+using namespace std;
+
+prefetcher::prefetcher (void) {
+	memset (strides, 0, sizeof (strides));
+	memset (streams, 0, sizeof (streams));
+	memset (inflight, 0, sizeof (inflight));
+	memset (pollution, 0, sizeof (pollution));
+	memset (&stats, 0, sizeof (stats));
+	stream_clock = 0;
+	kind = PF_NONE;
+	level = 2;
+	degree = 2;
+	distance = 1;
+	now = 0;
+	memory_latency = 270;
+	nreads = nwrites = 0;
+	wait = 0;
+}
+
+bool prefetcher::configure (const char *name, int l, int deg, int dist) {
+	if (!strcmp (name, "none")) kind = PF_NONE;
+	else if (!strcmp (name, "nextline")) kind = PF_NEXTLINE;
+	else if (!strcmp (name, "stride")) kind = PF_STRIDE;
+	else if (!strcmp (name, "stream")) kind = PF_STREAM;
+	else return false;
+	level = l == 3 ? 3 : 2;
+	degree = deg < 1 ? 1 : deg > PF_MAX_DEGREE ? PF_MAX_DEGREE : deg;
+	distance = dist < 0 ? 0 : dist;
+	return true;
+}
+
+// add block (a block number) to the candidates unless it is the trigger
+// or, if same_page, off the trigger's page. the top byte of an address is
+// the core's, so strides don't get to change it.
+
+int prefetcher::add (unsigned long long int *out, int n, unsigned long long int block, unsigned long long int base, bool same_page) {
+	if (block == base) return n;
+	if (same_page && block / PF_PAGE_BLOCKS != base / PF_PAGE_BLOCKS) return n;
+	out[n++] = ((block << 6) & 0x00ffffffffffffffull) | ((base << 6) & 0xff00000000000000ull);
+	return n;
+}
+
+int prefetcher::train (unsigned long long int address, unsigned long long int pc, bool miss, unsigned long long int *out) {
+	unsigned long long int block = address >> 6;
+	int n = 0;
+	stats.triggers++;
+	if (miss) stats.demand_misses++;
+	switch (kind) {
+	case PF_NEXTLINE:
+		for (int k=0; k<degree; k++) n = add (out, n, block + distance + k, block, true);
+		break;
+
+	case PF_STRIDE: {
+		pf_stride_entry *e = &strides[(pc ^ (pc >> 8)) % PF_STRIDE_ENTRIES];
+		if (e->pc != pc) {
+			e->pc = pc;
+			e->last = block;
+			e->stride = 0;
+			e->confidence = 0;
+			break;
+		}
+		long long int s = (long long int) (block - e->last);
+		if (s == 0) break;
+		if (s == e->stride) {
+			if (e->confidence < 3) e->confidence++;
+		} else if (e->confidence > 0) e->confidence--;
+		else e->stride = s;
+		e->last = block;
+		if (e->confidence >= 2)
+			for (int k=0; k<degree; k++) n = add (out, n, block + e->stride * (distance + k), block, false);
+		break;
+	}
+
+	case PF_STREAM: {
+		unsigned long long int page = block / PF_PAGE_BLOCKS;
+		pf_stream_entry *e = NULL, *victim = &streams[0];
+		for (int i=0; i<PF_STREAMS; i++) {
+			if (streams[i].page == page && streams[i].lru) { e = &streams[i]; break; }
+			if (streams[i].lru < victim->lru) victim = &streams[i];
+		}
+		if (!e) {
+			e = victim;
+			e->page = page;
+			e->last = block;
+			e->direction = 0;
+			e->confidence = 0;
+			e->lru = ++stream_clock;
+			break;
+		}
+		e->lru = ++stream_clock;
+		if (block == e->last) break;
+		int d = block > e->last ? 1 : -1;
+		if (d == e->direction) {
+			if (e->confidence < 3) e->confidence++;
+		} else {
+			e->direction = d;
+			e->confidence = 1;
+		}
+		e->last = block;
+		if (e->confidence >= 2)
+			for (int k=0; k<degree; k++) n = add (out, n, block + d * (distance + k), block, true);
+		break;
+	}
+	}
+	stats.candidates += n;
+	return n;
+}
+
+void prefetcher::issued (unsigned long long int address, unsigned long long int latency) {
+	unsigned long long int block = address >> 6;
+	pf_inflight *f = &inflight[block % PF_INFLIGHT];
+	f->block = block;
+	f->ready = now + latency;
+	stats.issued++;
+}
+
+void prefetcher::set_ready (unsigned long long int address, unsigned long long int ready) {
+	unsigned long long int block = address >> 6;
+	pf_inflight *f = &inflight[block % PF_INFLIGHT];
+	if (f->block == block) f->ready = ready;
+}
+
+void prefetcher::evicted (unsigned long long int victim) {
+	if (!victim) return;
+	unsigned long long int block = victim >> 6;
+	pollution[block % PF_POLLUTION_ENTRIES] = block;
+}
+
+// a demand access hit a block this prefetcher brought in
+
+void prefetcher::demand_hit (unsigned long long int address) {
+	unsigned long long int block = address >> 6;
+	pf_inflight *f = &inflight[block % PF_INFLIGHT];
+	stats.useful++;
+	if (f->block == block && now < f->ready) {
+		stats.late++;
+		wait = f->ready - now;
+	}
+}
+
+// a demand access missed at the prefetcher's level
+
+void prefetcher::demand_miss (unsigned long long int address) {
+	unsigned long long int block = address >> 6;
+	unsigned long long int *p = &pollution[block % PF_POLLUTION_ENTRIES];
+	if (*p == block) {
+		stats.polluting++;
+		*p = 0;
+	}
+}
+
+void prefetcher::report (FILE *f, int core, const prefetch_stats *since) {
+	static const char *names[] = { "none", "nextline", "stride", "stream" };
+	unsigned long long int issued = stats.issued - since->issued, useful = stats.useful - since->useful;
+	unsigned long long int misses = stats.demand_misses - since->demand_misses;
+	fprintf (f, "prefetch core %d: %s at %s, degree %d, distance %d: %lld candidates, %lld redundant, %lld issued (%lld from LLC)\n",
+		core, names[kind], level == 3 ? "LLC" : "L2", degree, distance,
+		stats.candidates - since->candidates, stats.redundant - since->redundant, issued, stats.from_llc - since->from_llc);
+	fprintf (f, "prefetch core %d: %lld useful (%lld late), %lld polluting, accuracy %0.4f, coverage %0.4f\n",
+		core, useful, stats.late - since->late, stats.polluting - since->polluting,
+		issued ? (double) useful / issued : 0.0, useful + misses ? (double) useful / (useful + misses) : 0.0);
+}
@@ -0,0 +1,115 @@
+#ifndef __PREFETCH_H
+#define __PREFETCH_H
+
+// hardware prefetcher stage. each core gets one, attached to its L2 or
+// to the LLC. it trains on the demand accesses that reach that level
+// (L1 misses for the L2, L2 misses for the LLC) and memory_access issues
+// its candidates as DAN_PREFETCH fills with access_source ACCESS_7 (into
+// the L2) or ACCESS_8 (into the LLC), so replacement policies can tell
+// them apart from demand fills and from prefetches recorded in the trace.
+//
+//	nextline	the blocks after the one accessed
+//	stride		per-PC stride detection; prefetches along a stride once
+//			it has been seen twice in a row
+//	stream		tracks up to 16 streams within 4KB pages and prefetches
+//			ahead in their direction once it is established
+//
+// DAN_PREFETCHER picks one (none by default), DAN_PREFETCH_LEVEL is 2 or 3
+// (2), DAN_PREFETCH_DEGREE is how many blocks to prefetch per trigger (2)
+// and DAN_PREFETCH_DISTANCE how many blocks or strides ahead to start (1).
+// with DAN_PREFETCH_LOW_PRIORITY=1 (the default) policies insert prefetch
+// fills at the LRU position instead of MRU.
+//
+// the hierarchy is exclusive, so a candidate already in the core's L1 or
+// L2 is dropped, and one in the LLC is moved up to the L2 rather than read
+// from memory again. a prefetch is useful if a demand access hits the block
+// before it is evicted, and late if that happens before the prefetch would
+// have completed; it pollutes if a demand access misses on a block that a
+// prefetch fill evicted.
+
+#define PF_NONE		0
+#define PF_NEXTLINE	1
+#define PF_STRIDE	2
+#define PF_STREAM	3
+
+#define PF_MAX_DEGREE		16
+#define PF_MAX_WRITES		(3*PF_MAX_DEGREE)	// up to three dirty victims per fill in a non-inclusive hierarchy
+#define PF_STRIDE_ENTRIES	256
+#define PF_STREAMS		16
+#define PF_INFLIGHT		64	// recent prefetches, for telling late ones
+#define PF_POLLUTION_ENTRIES	1024	// blocks evicted by prefetch fills
+#define PF_PAGE_BLOCKS		64	// 4KB pages of 64-byte blocks
+#define PF_LLC_LATENCY		40	// moving a block up from the LLC
+
+struct prefetch_stats {
+	unsigned long long int triggers;	// demand accesses trained on
+	unsigned long long int demand_misses;	// of those, the ones that missed at the prefetcher's level
+	unsigned long long int candidates;
+	unsigned long long int redundant;	// candidates already in L1, L2 or the target
+	unsigned long long int issued;		// prefetch fills
+	unsigned long long int from_llc;	// of those, blocks moved up from the LLC
+	unsigned long long int useful, late, polluting;
+};
+
+struct pf_stride_entry {
+	unsigned long long int pc, last;
+	long long int stride;
+	int confidence;
+};
+
+struct pf_stream_entry {
+	unsigned long long int page, last, lru;
+	int direction, confidence;
+};
+
+struct pf_inflight {
+	unsigned long long int block, ready;
+};
+
+class prefetcher {
+	pf_stride_entry strides[PF_STRIDE_ENTRIES];
+	pf_stream_entry streams[PF_STREAMS];
+	pf_inflight inflight[PF_INFLIGHT];
+	unsigned long long int pollution[PF_POLLUTION_ENTRIES];
+	unsigned long long int stream_clock;
+
+	int add (unsigned long long int *out, int n, unsigned long long int block, unsigned long long int base, bool same_page);
+
+public:
+	int kind, level, degree, distance;
+	prefetch_stats stats;
+
+	// the core's estimated clock, set by the caller before each access
+	unsigned long long int now;
+	unsigned long long int memory_latency;
+
+	// blocks the last memory_access prefetched from memory, and dirty
+	// blocks its prefetch fills pushed out to memory
+	unsigned long long int memory_reads[PF_MAX_DEGREE];
+	unsigned long long int memory_writes[PF_MAX_WRITES];
+	int nreads, nwrites;
+
+	// how long the last memory_access's demand access has to wait for a
+	// late prefetch of its block, or 0
+	unsigned long long int wait;
+
+	prefetcher (void);
+
+	// returns false if the name isn't a known prefetcher
+	bool configure (const char *name, int level, int degree, int distance);
+
+	// train on a demand access reaching the prefetcher's level and fill
+	// out with the byte addresses of blocks to prefetch; returns how many
+	int train (unsigned long long int address, unsigned long long int pc, bool miss, unsigned long long int *out);
+
+	// bookkeeping for issued prefetches and their effects
+	void issued (unsigned long long int address, unsigned long long int latency);
+	void set_ready (unsigned long long int address, unsigned long long int ready);
+	void evicted (unsigned long long int victim);
+	void demand_hit (unsigned long long int address);
+	void demand_miss (unsigned long long int address);
+
+	void report (FILE *f, int core, const prefetch_stats *since);
+};
+
+#endif
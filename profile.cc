@@ -0,0 +1,82 @@
+// storage and end-of-run report for the hot path profiler
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <mutex>
+#include "profile.h"
+
+#ifdef PROFILE
+
+thread_local prof_stage prof_stages[PROF_MAX];
+thread_local unsigned long long int prof_random;
+unsigned long long int prof_mask = 63;
+
+// every thread's counts once it has flushed them
+static prof_stage prof_totals[PROF_MAX];
+static std::mutex prof_lock;
+
+static const char *prof_names[PROF_MAX] = {
+	"trace read (inflate)",
+	"opcode translation",
+	"memory_access",
+	"  L1 lookup/fill",
+	"  L2 lookup/fill",
+	"  LLC lookup/fill",
+	"  invalidate",
+	"  victim selection",
+	"  replacement update",
+	"  path: L1 hit",
+	"  path: L2 hit",
+	"  path: LLC hit",
+	"  path: LLC miss",
+	"  + writebacks (any path)",
+};
+
+static unsigned long long int start_tsc;
+static struct timespec start_time;
+
+void prof_init (void) {
+	char *s = getenv ("DAN_PROF_SAMPLE");
+	if (s) {
+		unsigned long long int n = strtoull (s, NULL, 0);
+		// round down to a power of two
+		unsigned long long int p = 1;
+		while (p * 2 <= n) p *= 2;
+		prof_mask = p - 1;
+		fprintf (stderr, "DAN_PROF_SAMPLE=%llu\n", p);
+	}
+	clock_gettime (CLOCK_MONOTONIC, &start_time);
+	start_tsc = prof_now ();
+}
+
+void prof_flush (void) {
+	std::lock_guard<std::mutex> guard (prof_lock);
+	for (int i=0; i<PROF_MAX; i++) {
+		prof_totals[i].calls += prof_stages[i].calls;
+		prof_totals[i].samples += prof_stages[i].samples;
+		prof_totals[i].cycles += prof_stages[i].cycles;
+		prof_stages[i].calls = prof_stages[i].samples = prof_stages[i].cycles = 0;
+	}
+}
+
+void prof_report (unsigned long long int records, unsigned long long int llc_accesses) {
+	prof_flush ();
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	double seconds = (now.tv_sec - start_time.tv_sec) + (now.tv_nsec - start_time.tv_nsec) / 1e9;
+	double total = (double) (prof_now () - start_tsc);
+	printf ("profile: about 1 in %llu calls timed, %0.0f ticks in %0.3f seconds\n", prof_mask + 1, total, seconds);
+	printf ("%-26s %14s %14s %10s %8s\n", "stage", "calls", "est. ticks", "ticks/call", "% total");
+	for (int i=0; i<PROF_MAX; i++) {
+		prof_stage *p = &prof_totals[i];
+		if (!p->calls) continue;
+		double est = p->samples ? p->cycles * ((double) p->calls / p->samples) : 0;
+		printf ("%-26s %14llu %14.0f %10.1f %7.2f%%\n", prof_names[i], p->calls, est,
+			p->samples ? (double) p->cycles / p->samples : 0.0, 100.0 * est / total);
+	}
+	if (seconds > 0) printf ("profile: %0.0f records/sec, %0.0f LLC accesses/sec\n", records / seconds, llc_accesses / seconds);
+	fflush (stdout);
+}
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+// self-profiling of the simulator's hot paths. compiled in with -DPROFILE
+// (make exclusiu-prof); without it every macro here expands to nothing.
+//
+// each stage counts all of its calls but only reads the time stamp counter
+// on about one call in DAN_PROF_SAMPLE (a power of two, 64 by default), so
+// the instrumentation costs little more than an increment. the gaps
+// between timed calls are drawn at random, from 1 to twice that less one,
+// so that sampling doesn't lock onto something periodic in the workload
+// (gzread refilling its buffer, say) and time only its slow or fast calls.
+// the report scales the sampled cycles up by calls/samples.
+//
+// the counts are per thread, so the pipeline's stages (sim.h) never
+// share them. a thread that finishes calls prof_flush to add its counts
+// to the process's totals, and the report flushes its own thread's before
+// printing them. with the pipeline memory_access runs in two halves on
+// two threads, so it and its paths are counted but not timed.
+
+// stages timed around a piece of work
+
+#define PROF_TRACE_READ		0	// gzread of one record, i.e. inflate
+#define PROF_TRANSLATE		1	// CMP$im to DAN_* opcode translation
+#define PROF_MEMORY_ACCESS	2	// all of memory_access
+#define PROF_L1			3	// cache_access on the L1
+#define PROF_L2			4	// cache_access on the L2
+#define PROF_L3			5	// cache_access on the LLC
+#define PROF_INVALIDATE		6
+#define PROF_VICTIM		7	// GetVictimInSet
+#define PROF_UPDATE		8	// UpdateReplacementState, e.g. UpdateRWP
+
+// memory_access broken down by where the demand access was satisfied.
+// these are filled in from the PROF_MEMORY_ACCESS sample, so the four
+// paths add up to it. PROF_PATH_WRITEBACKS is a separate tally of the
+// accesses, on any path, that also wrote victims back.
+
+#define PROF_PATH_L1_HIT	9
+#define PROF_PATH_L2_HIT	10
+#define PROF_PATH_L3_HIT	11
+#define PROF_PATH_L3_MISS	12
+#define PROF_PATH_WRITEBACKS	13	// not a path: any access that also wrote victims back
+#define PROF_MAX		14
+
+#ifdef PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline unsigned long long int prof_now (void) { return __rdtsc (); }
+#else
+#include <time.h>
+static inline unsigned long long int prof_now (void) {
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#endif
+
+struct prof_stage {
+	unsigned long long int calls, samples, cycles;
+	unsigned long long int countdown;	// calls left until the next timed one
+};
+
+extern thread_local prof_stage prof_stages[PROF_MAX];
+extern thread_local unsigned long long int prof_random;	// xorshift state
+extern unsigned long long int prof_mask;
+
+// calls until the next timed one, prof_mask + 1 on average
+
+static inline unsigned long long int prof_gap (void) {
+	if (!prof_random) prof_random = 0x9e3779b97f4a7c15ull ^ (unsigned long long int) &prof_random;
+	prof_random ^= prof_random << 13;
+	prof_random ^= prof_random >> 7;
+	prof_random ^= prof_random << 17;
+	return 1 + prof_random % (2 * prof_mask + 1);
+}
+
+static inline unsigned long long int prof_begin (int s) {
+	prof_stages[s].calls++;
+	if (prof_stages[s].countdown > 1) {
+		prof_stages[s].countdown--;
+		return 0;
+	}
+	prof_stages[s].countdown = prof_gap ();
+	return prof_now ();
+}
+
+static inline void prof_end (int s, unsigned long long int t) {
+	if (t) {
+		prof_stages[s].cycles += prof_now () - t;
+		prof_stages[s].samples++;
+	}
+}
+
+#define PROF_BEGIN(s,v)		unsigned long long int v = prof_begin (s)
+#define PROF_END(s,v)		prof_end (s, v)
+#define PROF_END_PATH(miss,v)	prof_end_path (miss, v)	// in cache.cc, it knows the MISS_* bits
+#define PROF_COUNT_PATH(miss)	prof_count_path (miss)	// an untimed memory_access that took that path
+
+void prof_count_path (unsigned int miss);
+
+// start the clock and read DAN_PROF_SAMPLE; add a finishing thread's
+// counts to the totals; print the report at the end
+
+void prof_init (void);
+void prof_flush (void);
+void prof_report (unsigned long long int records, unsigned long long int llc_accesses);
+
+#else
+
+#define PROF_BEGIN(s,v)
+#define PROF_END(s,v)
+#define PROF_END_PATH(miss,v)
+#define PROF_COUNT_PATH(miss)
+#define prof_init()
+#define prof_flush()
+#define prof_report(records,llc_accesses)
+
+#endif
+
+#endif
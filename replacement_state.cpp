@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 #include <math.h>
 #include <sys/mman.h>
 #include <map>
@@ -10,6 +11,8 @@
 using namespace std;
 
 #include "replacement_state.h"
+#include "profile.h"
+#include "arena.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -26,6 +29,22 @@ using namespace std;
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
+// The policies' parameters. Each one is read from the environment by
+// sim_config_from_env and can be searched over by the tuner.
+const param policy_param_table[] = {
+    {"DAN_RWP_COUNTER_BITS", PARAM_INT, offsetof(policy_params, rwpCounterBits), 32, 1, 32,
+     "width of RWP's read hit counters; they all halve when one saturates"},
+    {"DAN_RWP_UPDATE_INTERVAL", PARAM_INT, offsetof(policy_params, rwpUpdateInterval), 1, 1, 1 << 20,
+     "recompute RWP's dirty partition size every this many updates"},
+    {"DAN_RWP_SAMPLE_SETS", PARAM_INT, offsetof(policy_params, rwpSampleSets), 0, 0, 1 << 22,
+     "train RWP's counters on about this many evenly spaced sets; 0 for all of them"},
+    {"DAN_RWP_PER_CORE", PARAM_INT, offsetof(policy_params, rwpPerCore), 0, 0, 1,
+     "1 for separate RWP counters and dirty partition targets for each core"},
+    {"DAN_RWP_EPOCH", PARAM_INT, offsetof(policy_params, rwpEpoch), 0, 0, 1 << 30,
+     "halve RWP's counters every this many updates, forgetting old phases; 0 never"},
+};
+const int policy_param_count = sizeof(policy_param_table) / sizeof(policy_param_table[0]);
+
 /*
 ** This file implements the cache replacement state. Users can enhance the code
 ** below to develop their cache replacement ideas.
@@ -41,35 +60,53 @@ using namespace std;
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 CACHE_REPLACEMENT_STATE::CACHE_REPLACEMENT_STATE(UINT32 _sets, UINT32 _assoc, UINT32 _pol)
+    : CACHE_REPLACEMENT_STATE(_sets, _assoc, _pol, NULL)
+{
+}
+
+CACHE_REPLACEMENT_STATE::CACHE_REPLACEMENT_STATE(UINT32 _sets, UINT32 _assoc, UINT32 _pol, arena *_mem)
 {
 
+    ownsMem = !_mem;
+    mem = _mem ? _mem : new arena;
+
     numsets = _sets;
     assoc = _assoc;
     replPolicy = _pol;
 
     mytimer = 0;
+    lowPriorityPrefetch = true;
 
     /* ------------------------------------------------------- */
     /* The following code is added as a part of RWP policy */
 
-    // for each line, initialise the  dirty and clean count to 0
-    dirtyCount = new UINT32[assoc];
-    cleanCount = new UINT32[assoc];
-    for (UINT32 LRUstackposition = 0; LRUstackposition < assoc; LRUstackposition++)
+    // for each line, initialise the  dirty and clean count to 0, for
+    // each core
+    dirtyCount = arena_new<UINT32>(mem, RWP_MAX_CORES * assoc);
+    cleanCount = arena_new<UINT32>(mem, RWP_MAX_CORES * assoc);
+    for (UINT32 i = 0; i < RWP_MAX_CORES * assoc; i++)
     {
-        dirtyCount[LRUstackposition] = 0;
-        cleanCount[LRUstackposition] = 0;
+        dirtyCount[i] = 0;
+        cleanCount[i] = 0;
     }
 
     // for each set, initialise the number of dirty lines to 0
-    numDirtyLines = new UINT32[numsets];
+    numDirtyLines = arena_new<UINT32>(mem, numsets);
     for (UINT32 set = 0; set < numsets; set++)
     {
         numDirtyLines[set] = 0;
     }
 
     // Initialise to 0 the predicted count of dirty lines
-    predNumDirtyLines = 0;
+    for (UINT32 row = 0; row < RWP_MAX_CORES; row++)
+    {
+        predNumDirtyLines[row] = 0;
+        predStale[row] = false;
+    }
+
+    policy_params defaults;
+    params_defaults(policy_param_table, policy_param_count, &defaults);
+    SetParams(defaults);
 
     /*End of RWP code for this function*/
     /* ------------------------------------------------------- */
@@ -77,6 +114,21 @@ CACHE_REPLACEMENT_STATE::CACHE_REPLACEMENT_STATE(UINT32 _sets, UINT32 _assoc, UI
     InitReplacementState();
 }
 
+void CACHE_REPLACEMENT_STATE::SetParams(const policy_params &p)
+{
+    params = p;
+    counterMax = params.rwpCounterBits >= 32 ? 0xffffffff : (1u << params.rwpCounterBits) - 1;
+    updatesToRecompute = params.rwpUpdateInterval;
+    updatesToEpoch = params.rwpEpoch;
+
+    // sample every stride'th set, the stride a power of two
+    UINT32 stride = 1;
+    if (params.rwpSampleSets > 0)
+        while (stride * 2 * params.rwpSampleSets <= numsets)
+            stride *= 2;
+    sampleMask = stride - 1;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 // The function prints the statistics for the cache                           //
@@ -90,6 +142,28 @@ ostream &CACHE_REPLACEMENT_STATE::PrintStats(ostream &out)
     out << "==========================================================" << endl;
 
     // CONTESTANTS:  Insert your statistics printing here
+    if (replPolicy == CRC_REPL_CONTESTANT)
+    {
+        // RWP: the current dirty partition size and the read hits seen at
+        // each stack position by dirty and clean lines
+        UINT32 rows = params.rwpPerCore ? RWP_MAX_CORES : 1;
+        for (UINT32 row = 0; row < rows; row++)
+        {
+            UINT32 *dirty = dirtyCount + row * assoc, *clean = cleanCount + row * assoc;
+            bool used = row == 0;
+            for (UINT32 pos = 0; pos < assoc; pos++)
+                used |= dirty[pos] || clean[pos];
+            if (!used)
+                continue;
+            if (params.rwpPerCore)
+                out << "RWP core " << row << ":" << endl;
+            out << "RWP predicted dirty lines per set: " << predNumDirtyLines[row] << endl;
+            out << "RWP read hits by stack position (dirty/clean):";
+            for (UINT32 pos = 0; pos < assoc; pos++)
+                out << " " << dirty[pos] << "/" << clean[pos];
+            out << endl;
+        }
+    }
 
     return out;
 }
@@ -105,16 +179,17 @@ void CACHE_REPLACEMENT_STATE::InitReplacementState()
 {
     // Create the state for sets, then create the state for the ways
 
-    repl = new LINE_REPLACEMENT_STATE *[numsets];
+    repl = arena_new<LINE_REPLACEMENT_STATE *>(mem, numsets);
 
     // ensure that we were able to create replacement state
 
     assert(repl);
 
-    // Create the state for the sets
+    // Create the state for the sets, one set after another
+    LINE_REPLACEMENT_STATE *lines = arena_new<LINE_REPLACEMENT_STATE>(mem, (size_t)numsets * assoc);
     for (UINT32 setIndex = 0; setIndex < numsets; setIndex++)
     {
-        repl[setIndex] = new LINE_REPLACEMENT_STATE[assoc];
+        repl[setIndex] = lines + (size_t)setIndex * assoc;
 
         for (UINT32 way = 0; way < assoc; way++)
         {
@@ -127,6 +202,7 @@ void CACHE_REPLACEMENT_STATE::InitReplacementState()
             repl[setIndex][way].dirtyShadowTag = 0;
             // initialize the dirty bit of the line
             repl[setIndex][way].dirtyBit = 0;
+            repl[setIndex][way].owner = 0;
         }
     }
 
@@ -146,25 +222,31 @@ void CACHE_REPLACEMENT_STATE::InitReplacementState()
 ////////////////////////////////////////////////////////////////////////////////
 INT32 CACHE_REPLACEMENT_STATE::GetVictimInSet(UINT32 tid, UINT32 setIndex, const LINE_STATE *vicSet, UINT32 assoc, Addr_t PC, Addr_t paddr, UINT32 accessType, UINT32 accessSource)
 {
+    INT32 way = -1;
+    PROF_BEGIN(PROF_VICTIM, prof_victim);
+
     // If no invalid lines, then replace based on replacement policy
     if (replPolicy == CRC_REPL_LRU)
     {
-        return Get_LRU_Victim(setIndex);
+        way = Get_LRU_Victim(setIndex);
     }
     else if (replPolicy == CRC_REPL_RANDOM)
     {
-        return Get_Random_Victim(setIndex);
+        way = Get_Random_Victim(setIndex);
     }
     else if (replPolicy == CRC_REPL_CONTESTANT)
     {
         // Contestants:  ADD YOUR VICTIM SELECTION FUNCTION HERE
-        return Get_My_Victim(setIndex, accessType);
+        way = Get_My_Victim(tid, setIndex, accessType);
+    }
+    else
+    {
+        // We should never reach here
+        assert(0);
     }
 
-    // We should never reach here
-
-    assert(0);
-    return -1;
+    PROF_END(PROF_VICTIM, prof_victim);
+    return way;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -181,6 +263,8 @@ void CACHE_REPLACEMENT_STATE::UpdateReplacementState(
     UINT32 setIndex, INT32 updateWayID, const LINE_STATE *currLine,
     UINT32 tid, Addr_t PC, UINT32 accessType, bool cacheHit, UINT32 accessSource)
 {
+    PROF_BEGIN(PROF_UPDATE, prof_update);
+
     // What replacement policy?
     if (replPolicy == CRC_REPL_LRU)
     {
@@ -195,8 +279,28 @@ void CACHE_REPLACEMENT_STATE::UpdateReplacementState(
         // Contestants:  ADD YOUR UPDATE REPLACEMENT STATE FUNCTION HERE
         // Feel free to use any of the input parameters to make
         // updates to your replacement policy
-        UpdateRWP(setIndex, updateWayID, accessType, cacheHit, currLine);
+        UpdateRWP(tid, setIndex, updateWayID, accessType, cacheHit, currLine);
     }
+
+    // a prefetched block hasn't shown it will be used, so let it be the
+    // next victim unless a demand access gets to it first
+    if (!cacheHit && lowPriorityPrefetch && accessSource >= ACCESS_SOURCE_PREFETCHER && replPolicy != CRC_REPL_RANDOM)
+    {
+        DemoteToLRU(setIndex, updateWayID);
+    }
+
+    PROF_END(PROF_UPDATE, prof_update);
+}
+
+// A block evicted from this set was read again soon after. RWP counts
+// that as a read hit at the bottom of the stack, in the directory the
+// block was evicted from, so the partition that would have kept it
+// longest gains; LRU and random have nothing to learn from it.
+void CACHE_REPLACEMENT_STATE::EarlyReuse(UINT32 tid, UINT32 setIndex, bool wasDirty)
+{
+    if (replPolicy != CRC_REPL_CONTESTANT || (setIndex & sampleMask) != 0)
+        return;
+    CountRWPHit(RWPRow(tid), wasDirty ? dirtyCount : cleanCount, assoc - 1);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -242,7 +346,7 @@ INT32 CACHE_REPLACEMENT_STATE::Get_LRU_Victim(UINT32 setIndex)
 ////////////////////////////////////////////////////////////////////////////////
 INT32 CACHE_REPLACEMENT_STATE::Get_Random_Victim(UINT32 setIndex)
 {
-    INT32 way = (rand() % assoc);
+    INT32 way = (random.next() % assoc);
 
     return way;
 }
@@ -275,14 +379,41 @@ void CACHE_REPLACEMENT_STATE::UpdateLRU(UINT32 setIndex, INT32 updateWayID)
     repl[setIndex][updateWayID].LRUstackposition = 0;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// This function moves a line to the bottom of the LRU stack, shifting the    //
+// lines below it up by one.                                                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+void CACHE_REPLACEMENT_STATE::DemoteToLRU(UINT32 setIndex, INT32 updateWayID)
+{
+    UINT32 currLRUstackposition = repl[setIndex][updateWayID].LRUstackposition;
+
+    for (UINT32 way = 0; way < assoc; way++)
+    {
+        if (repl[setIndex][way].LRUstackposition > currLRUstackposition)
+        {
+            repl[setIndex][way].LRUstackposition--;
+        }
+    }
+    repl[setIndex][updateWayID].LRUstackposition = assoc - 1;
+}
+
 /*  Find Victim in RWP based LRU
     This function finds the Optimised LRU (RWP) victim in the cache set
     by predicting the number of dirty lines.
     It prioritises to protect read lines over write lines.
     It also evicts only that write line that may not serve read requests.
+    With a predictor per core, see Get_Per_Core_Victim.
 */
-INT32 CACHE_REPLACEMENT_STATE::Get_My_Victim(UINT32 setIndex, UINT32 at)
+INT32 CACHE_REPLACEMENT_STATE::Get_My_Victim(UINT32 tid, UINT32 setIndex, UINT32 at)
 {
+    if (params.rwpPerCore)
+        return Get_Per_Core_Victim(setIndex);
+
+    UINT32 predNumDirtyLines = this->predNumDirtyLines[0];
+
     // Initialization for the initial situation
     if ((predNumDirtyLines == 0) && (numDirtyLines[setIndex] == 0))
     {
@@ -339,7 +470,54 @@ INT32 CACHE_REPLACEMENT_STATE::Get_My_Victim(UINT32 setIndex, UINT32 at)
     return false;
 }
 
-void CACHE_REPLACEMENT_STATE::UpdateRWP(UINT32 setIndex, INT32 updateWayID,
+/*  With a predictor per core, each core's lines in the set are held to
+    that core's own target: a core with fewer dirty lines here than it
+    predicts offers its clean lines, and one with as many or more offers
+    its dirty lines (all of them before it has a prediction or a dirty
+    line, as above). The victim is the LRU line on offer, so the cores
+    still compete for the set's capacity by recency, and if none is on
+    offer it is the LRU line of the set.
+*/
+INT32 CACHE_REPLACEMENT_STATE::Get_Per_Core_Victim(UINT32 setIndex)
+{
+    LINE_REPLACEMENT_STATE *replSet = repl[setIndex];
+    UINT32 dirtyLines[RWP_MAX_CORES];
+    for (UINT32 row = 0; row < RWP_MAX_CORES; row++)
+        dirtyLines[row] = 0;
+    for (UINT32 way = 0; way < assoc; way++)
+        dirtyLines[replSet[way].owner] += replSet[way].dirtyBit;
+
+    INT32 evictBlkIdx = -1, lruWay = 0;
+    for (UINT32 way = 0; way < assoc; way++)
+    {
+        if (replSet[way].LRUstackposition > replSet[lruWay].LRUstackposition)
+            lruWay = way;
+        UINT32 row = replSet[way].owner;
+        UINT32 pred = predNumDirtyLines[row];
+        bool offered;
+        if (pred == 0 && dirtyLines[row] == 0)
+            offered = true;
+        else if (pred > dirtyLines[row])
+            offered = replSet[way].dirtyBit == 0;
+        else
+            offered = replSet[way].dirtyBit == 1;
+        if (offered && (evictBlkIdx < 0 || replSet[way].LRUstackposition > replSet[evictBlkIdx].LRUstackposition))
+            evictBlkIdx = way;
+    }
+    return evictBlkIdx < 0 ? lruWay : evictBlkIdx;
+}
+
+UINT32 CACHE_REPLACEMENT_STATE::GetNumDirtyLines(UINT32 setIndex, UINT32 tid)
+{
+    if (!params.rwpPerCore)
+        return numDirtyLines[setIndex];
+    UINT32 row = RWPRow(tid), n = 0;
+    for (UINT32 way = 0; way < assoc; way++)
+        n += repl[setIndex][way].owner == row && repl[setIndex][way].dirtyBit;
+    return n;
+}
+
+void CACHE_REPLACEMENT_STATE::UpdateRWP(UINT32 tid, UINT32 setIndex, INT32 updateWayID,
                                         UINT32 accessType, bool hit, const LINE_STATE *currLine)
 {
     // get the tag and current LRU positions of the line
@@ -349,6 +527,8 @@ void CACHE_REPLACEMENT_STATE::UpdateRWP(UINT32 setIndex, INT32 updateWayID,
     /* 1. Update clean/dirty directories */
     if (!hit)
     {
+        repl[setIndex][updateWayID].owner = RWPRow(tid);
+
         // Write miss: allocate line to dirty directory;
         if (accessType == ACCESS_STORE || accessType == ACCESS_WRITEBACK)
         {
@@ -393,10 +573,14 @@ void CACHE_REPLACEMENT_STATE::UpdateRWP(UINT32 setIndex, INT32 updateWayID,
         else if (accessType == ACCESS_PREFETCH || accessType == ACCESS_LOAD || accessType == ACCESS_IFETCH)
 
         {
-            if (repl[setIndex][updateWayID].dirtyShadowTag != 0)
-                dirtyCount[currLRUstackposition]++;
-            else if (repl[setIndex][updateWayID].cleanShadowTag != 0)
-                cleanCount[currLRUstackposition]++;
+            // only the sampled sets train the counters
+            if ((setIndex & sampleMask) == 0)
+            {
+                if (repl[setIndex][updateWayID].dirtyShadowTag != 0)
+                    CountRWPHit(RWPRow(tid), dirtyCount, currLRUstackposition);
+                else if (repl[setIndex][updateWayID].cleanShadowTag != 0)
+                    CountRWPHit(RWPRow(tid), cleanCount, currLRUstackposition);
+            }
         }
     }
 
@@ -413,27 +597,92 @@ void CACHE_REPLACEMENT_STATE::UpdateRWP(UINT32 setIndex, INT32 updateWayID,
     repl[setIndex][updateWayID].LRUstackposition = 0;
 
     /* 3. Update prediction of dirty lines */
+    // Age the counters at the end of each epoch, and only every
+    // rwpUpdateInterval'th update recomputes the predictions whose
+    // counters have changed
+    if (params.rwpEpoch && --updatesToEpoch == 0)
+    {
+        updatesToEpoch = params.rwpEpoch;
+        AgeRWPCounters();
+    }
+    if (--updatesToRecompute)
+        return;
+    updatesToRecompute = params.rwpUpdateInterval;
+    UINT32 rows = params.rwpPerCore ? RWP_MAX_CORES : 1;
+    for (UINT32 row = 0; row < rows; row++)
+    {
+        if (predStale[row])
+            PredictDirtyLines(row);
+    }
+}
+
+// Predict the dirty partition size for one row of counters
+void CACHE_REPLACEMENT_STATE::PredictDirtyLines(UINT32 row)
+{
+    UINT32 *dirtyCount = this->dirtyCount + row * assoc, *cleanCount = this->cleanCount + row * assoc;
+    predStale[row] = false;
+
     //Add all the dirty and clean values and update the counters by ways.
+    //Each partition adds the dirty hits above it and the clean hits below it,
+    //kept as running sums so this is linear in the associativity.
     UINT32 max = 0, totalCleanLines = 0, totalDirtyLines = 0;
+    UINT32 dirtyAbove = 0, cleanBelow = 0;
+    for (UINT32 cPart = 0; cPart < assoc; cPart++)
+    {
+        cleanBelow += cleanCount[cPart];
+    }
     for (UINT32 part = 0; part <= assoc; part++)
     {
-        for (UINT32 dPart = 0; dPart < part; dPart++)
-        {
-            totalDirtyLines += dirtyCount[dPart];
-        }
-        for (UINT32 cPart = part; cPart < assoc; cPart++)
+        totalDirtyLines += dirtyAbove;
+        totalCleanLines += cleanBelow;
+        if (part < assoc)
         {
-            totalCleanLines += cleanCount[cPart];
+            dirtyAbove += dirtyCount[part];
+            cleanBelow -= cleanCount[part];
         }
         if (max < (totalCleanLines + totalDirtyLines))
         {
             max = totalCleanLines + totalDirtyLines;
             // Partition here
-            predNumDirtyLines = part;
+            predNumDirtyLines[row] = part;
         }
     }
 }
 
+// Count a read hit at a stack position in a core's row. When the counter
+// would saturate, every counter in the row is halved so their ratios are
+// kept.
+void CACHE_REPLACEMENT_STATE::CountRWPHit(UINT32 row, UINT32 *counts, UINT32 pos)
+{
+    UINT32 *dirty = dirtyCount + row * assoc, *clean = cleanCount + row * assoc;
+    counts += row * assoc;
+    if (counts[pos] >= counterMax)
+    {
+        for (UINT32 way = 0; way < assoc; way++)
+        {
+            dirty[way] >>= 1;
+            clean[way] >>= 1;
+        }
+    }
+    counts[pos]++;
+    predStale[row] = true;
+}
+
+// Halve every counter at the end of an epoch so old phases fade
+void CACHE_REPLACEMENT_STATE::AgeRWPCounters()
+{
+    UINT32 rows = params.rwpPerCore ? RWP_MAX_CORES : 1;
+    for (UINT32 i = 0; i < rows * assoc; i++)
+    {
+        dirtyCount[i] >>= 1;
+        cleanCount[i] >>= 1;
+    }
+    for (UINT32 row = 0; row < rows; row++)
+        predStale[row] = true;
+}
+
 CACHE_REPLACEMENT_STATE::~CACHE_REPLACEMENT_STATE(void)
 {
+    if (ownsMem)
+        delete mem;
 }
@@ -20,10 +20,17 @@
 #include <cassert>
 #include "utils.h"
 #include "crc_cache_defs.h"
+#include "params.h"
 #include <iostream>
 
+class arena;
+
 using namespace std;
 
+// access sources from this one up are fills by the prefetcher stage
+// (ACCESS_7 and ACCESS_8 in cache.h)
+#define ACCESS_SOURCE_PREFETCHER 7
+
 // Replacement Policies Supported
 typedef enum
 {
@@ -39,14 +46,33 @@ typedef struct
 
   // CONTESTANTS: Add extra state per cache line here
   // Cache lines status flags
+  UINT32 dirtyBit;
   UINT64 cleanShadowTag;
   UINT64 dirtyShadowTag;
-  UINT32 dirtyBit;
+  UINT32 owner; // RWP row of the core that filled it
 
 } LINE_REPLACEMENT_STATE;
 
 struct sampler; // Jimenez's structures
 
+// RWP keeps a predictor per core if asked to; cores past this share
+#define RWP_MAX_CORES 16
+
+// The policies' tunable parameters, read through the registry in params.h
+// (policy_param_table lists them). The defaults are the policies as
+// published.
+struct policy_params
+{
+  int rwpCounterBits;    // width of RWP's hit counters; all halve when one saturates
+  int rwpUpdateInterval; // recompute the dirty partition every this many updates
+  int rwpSampleSets;     // train on about this many sets, 0 for all of them
+  int rwpPerCore;        // a predictor and dirty partition target per core
+  int rwpEpoch;          // halve the counters every this many updates, 0 never
+};
+
+extern const param policy_param_table[];
+extern const int policy_param_count;
+
 // The implementation for the cache replacement policy
 class CACHE_REPLACEMENT_STATE
 {
@@ -61,11 +87,30 @@ private:
   COUNTER mytimer; // tracks # of references to the cache
 
   // CONTESTANTS:  Add extra state for cache here
-  // Cache status variables
+  // Cache status variables. The read hit histograms and the prediction
+  // have a row per core, RWP_MAX_CORES of them; only row 0 is used unless
+  // rwpPerCore is set.
   UINT32 *dirtyCount;
   UINT32 *cleanCount;
   UINT32 *numDirtyLines;
-  UINT32 predNumDirtyLines;
+  UINT32 predNumDirtyLines[RWP_MAX_CORES];
+  bool predStale[RWP_MAX_CORES];
+  UINT32 counterMax;
+  UINT32 sampleMask;
+  UINT32 updatesToRecompute;
+  UINT32 updatesToEpoch;
+  policy_params params;
+
+  // where the state above lives; the destructor gives it back if it is
+  // the replacement state's own
+  arena *mem;
+  bool ownsMem;
+
+  // insert prefetcher fills at the bottom of the stack
+  bool lowPriorityPrefetch;
+
+  // victims for the random policy
+  xorshift random;
 
 public:
   ostream &PrintStats(ostream &out);
@@ -73,16 +118,30 @@ public:
   // The constructor CAN NOT be changed
   CACHE_REPLACEMENT_STATE(UINT32 _sets, UINT32 _assoc, UINT32 _pol);
 
+  // the same, with the state in _mem instead of an arena of its own
+  CACHE_REPLACEMENT_STATE(UINT32 _sets, UINT32 _assoc, UINT32 _pol, arena *_mem);
+
   INT32 GetVictimInSet(UINT32 tid, UINT32 setIndex, const LINE_STATE *vicSet, UINT32 assoc, Addr_t PC, Addr_t paddr, UINT32 accessType, UINT32 accessSource);
 
   void UpdateReplacementState(UINT32 setIndex, INT32 updateWayID);
 
   void SetReplacementPolicy(UINT32 _pol) { replPolicy = _pol; }
+  UINT32 GetPredNumDirtyLines(UINT32 tid = 0) { return predNumDirtyLines[RWPRow(tid)]; }
+  UINT32 GetNumDirtyLines(UINT32 setIndex) { return numDirtyLines[setIndex]; }
+  // with a prediction per core, only the lines this core filled
+  UINT32 GetNumDirtyLines(UINT32 setIndex, UINT32 tid);
   void IncrementTimer() { mytimer++; }
+  void SetPrefetchInsertion(bool lowPriority) { lowPriorityPrefetch = lowPriority; }
+  void SetParams(const policy_params &p);
+  bool LowPriorityPrefetch() { return lowPriorityPrefetch; }
 
   void UpdateReplacementState(UINT32 setIndex, INT32 updateWayID, const LINE_STATE *currLine,
                               UINT32 tid, Addr_t PC, UINT32 accessType, bool cacheHit, UINT32 accessSource);
 
+  // a block this set evicted, dirty or clean, was read again soon after
+  // (from the victim buffer)
+  void EarlyReuse(UINT32 tid, UINT32 setIndex, bool wasDirty);
+
   ~CACHE_REPLACEMENT_STATE(void);
 
 private:
@@ -90,9 +149,15 @@ private:
   INT32 Get_Random_Victim(UINT32 setIndex);
 
   INT32 Get_LRU_Victim(UINT32 setIndex);
-  INT32 Get_My_Victim(UINT32 setIndex, UINT32 accessType);
+  INT32 Get_My_Victim(UINT32 tid, UINT32 setIndex, UINT32 accessType);
+  INT32 Get_Per_Core_Victim(UINT32 setIndex);
   void UpdateLRU(UINT32 setIndex, INT32 updateWayID);
-  void UpdateRWP(UINT32 setIndex, INT32 updateWayID, UINT32 accessType, bool hit, const LINE_STATE *currLine);
+  void DemoteToLRU(UINT32 setIndex, INT32 updateWayID);
+  void UpdateRWP(UINT32 tid, UINT32 setIndex, INT32 updateWayID, UINT32 accessType, bool hit, const LINE_STATE *currLine);
+  UINT32 RWPRow(UINT32 tid) { return params.rwpPerCore ? tid % RWP_MAX_CORES : 0; }
+  void CountRWPHit(UINT32 row, UINT32 *counts, UINT32 pos);
+  void AgeRWPCounters();
+  void PredictDirtyLines(UINT32 row);
 };
 
 #endif
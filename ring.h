@@ -0,0 +1,49 @@
+#ifndef __RING_H
+#define __RING_H
+
+// a bounded single-producer, single-consumer queue for handing work from
+// one pipeline stage's thread to the next. push waits while it is full and
+// pop while it is empty, spinning for a while and then yielding the
+// processor so it still makes progress with fewer processors than stages.
+
+#include <atomic>
+#include <thread>
+
+template <class T, unsigned int N> class spsc_ring {
+	T items[N];
+	alignas (64) std::atomic<unsigned int> head;	// next to pop
+	alignas (64) std::atomic<unsigned int> tail;	// next to push
+
+	static void wait (int *spins) {
+		if (++*spins > 64) std::this_thread::yield ();
+	}
+
+public:
+	spsc_ring (void) : head (0), tail (0) { }
+
+	void push (const T &x) {
+		unsigned int t = tail.load (std::memory_order_relaxed);
+		int spins = 0;
+		while (t - head.load (std::memory_order_acquire) == N) wait (&spins);
+		items[t % N] = x;
+		tail.store (t + 1, std::memory_order_release);
+	}
+
+	void pop (T *x) {
+		unsigned int h = head.load (std::memory_order_relaxed);
+		int spins = 0;
+		while (tail.load (std::memory_order_acquire) == h) wait (&spins);
+		*x = items[h % N];
+		head.store (h + 1, std::memory_order_release);
+	}
+
+	// the item k after the next one pop would return, or NULL if it
+	// hasn't been pushed yet. only the consumer may call this
+	const T *peek (unsigned int k) {
+		unsigned int h = head.load (std::memory_order_relaxed);
+		if (tail.load (std::memory_order_acquire) - h <= k) return NULL;
+		return &items[(h + k) % N];
+	}
+};
+
+#endif
@@ -0,0 +1,311 @@
+// run exclusiu as a child process and scrape its results
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "pool.h"
+#include "runner.h"
+
+using namespace std;
+
+extern char **environ;
+
+std::string runner_getenv (const char *name, const char *def) {
+	char *s = getenv (name);
+	return s ? s : def;
+}
+
+const char *runner_binary (void) {
+	char *s = getenv ("DAN_EXCLUSIU");
+	return s ? s : "./exclusiu";
+}
+
+std::string runner_trace_path (const std::string &name) {
+	// a name that already looks like a path is used as it is
+
+	if (name.find ('/') != string::npos || name.find (".gz") != string::npos) return name;
+	return runner_getenv ("DAN_TRACE_DIR", "traces") + "/" + name + ".gz";
+}
+
+int runner_jobs (void) {
+	int n = 0;
+	char *s = getenv ("DAN_JOBS");
+	if (s) n = atoi (s);
+	if (n <= 0) n = (int) sysconf (_SC_NPROCESSORS_ONLN);
+	if (n <= 0) n = 1;
+	return n;
+}
+
+std::vector<std::string> read_benchmark_list (const char *filename) {
+	std::vector<std::string> v;
+	FILE *f = fopen (filename, "r");
+	if (!f) {
+		perror (filename);
+		return v;
+	}
+	char line[1000];
+	while (fgets (line, sizeof (line), f)) {
+		char name[1000];
+		if (line[0] == '#') continue;
+		if (sscanf (line, "%999s", name) == 1) v.push_back (name);
+	}
+	fclose (f);
+	return v;
+}
+
+// pick the numbers out of exclusiu's output. print_stats runs every
+// 100M iterations, so later lines overwrite earlier ones and we end up
+// with the final statistics.
+
+static void parse_line (const char *line, run_result *r) {
+	int core, n;
+	double x;
+	if (sscanf (line, "core %d: %lf IPC", &core, &x) == 2) {
+		if (core >= 0 && core < RUNNER_MAX_CORES) {
+			r->ipc[core] = x;
+			if (core + 1 > r->ncores) r->ncores = core + 1;
+		}
+	} else if (strncmp (line, "L3 mpki: ", 9) == 0) {
+		const char *p = line + 9;
+		while (sscanf (p, "core %d: %lf %n", &core, &x, &n) == 2) {
+			if (core >= 0 && core < RUNNER_MAX_CORES) r->mpki[core] = x;
+			p += n;
+		}
+	}
+}
+
+// the end of a failed child's stderr, indented under the failure
+
+#define RUNNER_ERR_TAIL	4096
+
+static void show_tail (FILE *err) {
+	char buf[RUNNER_ERR_TAIL + 1];
+	long size;
+	fflush (err);
+	if (fseek (err, 0, SEEK_END) != 0 || (size = ftell (err)) <= 0) return;
+	fseek (err, size > RUNNER_ERR_TAIL ? size - RUNNER_ERR_TAIL : 0, SEEK_SET);
+	size_t n = fread (buf, 1, RUNNER_ERR_TAIL, err);
+	buf[n] = 0;
+	char *p = buf;
+	// start at a line if we came in part way through one
+	if (size > RUNNER_ERR_TAIL) {
+		char *nl = strchr (p, '\n');
+		if (nl) p = nl + 1;
+	}
+	while (*p) {
+		char *nl = strchr (p, '\n');
+		if (nl) *nl = 0;
+		fprintf (stderr, "\t%s\n", p);
+		if (!nl) break;
+		p = nl + 1;
+	}
+}
+
+bool run_one (run_job *j) {
+	// build the argument and environment vectors before forking so the
+	// child only has to exec
+
+	vector<string> paths;
+	for (size_t i=0; i<j->traces.size(); i++) paths.push_back (runner_trace_path (j->traces[i]));
+	vector<char *> argv, envp;
+	argv.push_back ((char *) runner_binary ());
+	for (size_t i=0; i<paths.size(); i++) argv.push_back ((char *) paths[i].c_str ());
+	argv.push_back (NULL);
+	for (char **e = environ; *e; e++) {
+		// settings in the job replace inherited ones with the same name
+		bool overridden = false;
+		for (size_t i=0; i<j->env.size(); i++) {
+			size_t eq = j->env[i].find ('=');
+			if (strncmp (*e, j->env[i].c_str (), eq + 1) == 0) overridden = true;
+		}
+		if (!overridden) envp.push_back (*e);
+	}
+	for (size_t i=0; i<j->env.size(); i++) envp.push_back ((char *) j->env[i].c_str ());
+	envp.push_back (NULL);
+
+	memset (&j->result, 0, sizeof (j->result));
+	j->ok = false;
+	// close-on-exec, or children started by other threads would hold
+	// our pipe open and we'd never see end of file
+	int fds[2];
+	if (pipe2 (fds, O_CLOEXEC) != 0) {
+		perror ("pipe");
+		return false;
+	}
+	// the child's stderr goes to a file of its own, shown if it fails
+	FILE *err = tmpfile ();
+	if (err) fcntl (fileno (err), F_SETFD, FD_CLOEXEC);
+	pid_t pid = fork ();
+	if (pid == 0) {
+		dup2 (fds[1], 1);
+		if (err) dup2 (fileno (err), 2);
+		close (fds[0]);
+		close (fds[1]);
+		execve (argv[0], &argv[0], &envp[0]);
+		fprintf (stderr, "%s: %s\n", argv[0], strerror (errno));
+		_exit (127);
+	}
+	close (fds[1]);
+	if (pid < 0) {
+		perror ("fork");
+		close (fds[0]);
+		if (err) fclose (err);
+		return false;
+	}
+	FILE *f = fdopen (fds[0], "r");
+	char line[10000];
+	while (fgets (line, sizeof (line), f)) parse_line (line, &j->result);
+	fclose (f);
+	int status;
+	waitpid (pid, &status, 0);
+	j->ok = WIFEXITED (status) && WEXITSTATUS (status) == 0 && j->result.ncores == (int) j->traces.size ();
+	if (!j->ok) {
+		fprintf (stderr, "simulation failed:");
+		for (size_t i=0; i<paths.size(); i++) fprintf (stderr, " %s", paths[i].c_str ());
+		if (WIFSIGNALED (status)) fprintf (stderr, " (signal %d)", WTERMSIG (status));
+		else if (WIFEXITED (status) && WEXITSTATUS (status)) fprintf (stderr, " (exit %d)", WEXITSTATUS (status));
+		fprintf (stderr, "\n");
+		if (err) show_tail (err);
+	}
+	if (err) fclose (err);
+	return j->ok;
+}
+
+// FNV-1a, good enough for telling configurations apart
+
+static unsigned long long int hash_bytes (unsigned long long int h, const void *p, size_t n) {
+	const unsigned char *c = (const unsigned char *) p;
+	for (size_t i=0; i<n; i++) {
+		h ^= c[i];
+		h *= 0x100000001b3ull;
+	}
+	return h;
+}
+
+static unsigned long long int hash_string (unsigned long long int h, const string &s) {
+	return hash_bytes (h, s.c_str (), s.size () + 1);
+}
+
+static unsigned long long int binary_hash (void) {
+	static once_flag once;
+	static unsigned long long int h;
+	call_once (once, [] () {
+		h = 0xcbf29ce484222325ull;
+		FILE *f = fopen (runner_binary (), "r");
+		if (!f) return;
+		char buf[1<<16];
+		size_t n;
+		while ((n = fread (buf, 1, sizeof (buf), f)) > 0) h = hash_bytes (h, buf, n);
+		fclose (f);
+	});
+	return h;
+}
+
+// settings that only matter to the drivers, not to a simulation
+
+static bool driver_setting (const char *s) {
+	static const char *names[] = {
+		"DAN_JOBS=", "DAN_EXCLUSIU=", "DAN_TRACE_DIR=", "DAN_RESULTS_CACHE=",
+		"DAN_ALONE_POLICY=", NULL };
+	for (int i=0; names[i]; i++) if (strncmp (s, names[i], strlen (names[i])) == 0) return true;
+	return false;
+}
+
+// a trace by its resolved path, so the same names in another directory
+// are other traces
+
+static string trace_id (const string &name) {
+	string path = runner_trace_path (name);
+	char *r = realpath (path.c_str (), NULL);
+	if (!r) return path;
+	path = r;
+	free (r);
+	return path;
+}
+
+unsigned long long int results_cache::key (const run_job &j) {
+	map<string,string> settings;
+	for (char **e = environ; *e; e++) {
+		if (strncmp (*e, "DAN_", 4) || driver_setting (*e)) continue;
+		string s = *e;
+		settings[s.substr (0, s.find ('='))] = s;
+	}
+	for (size_t i=0; i<j.env.size(); i++)
+		settings[j.env[i].substr (0, j.env[i].find ('='))] = j.env[i];
+	unsigned long long int h = 0xcbf29ce484222325ull;
+	// the trace files themselves, wherever DAN_TRACE_DIR puts them
+	for (size_t i=0; i<j.traces.size(); i++) h = hash_string (h, trace_id (j.traces[i]));
+	for (map<string,string>::iterator p = settings.begin (); p != settings.end (); p++) h = hash_string (h, p->second);
+	unsigned long long int b = binary_hash ();
+	return hash_bytes (h, &b, sizeof (b));
+}
+
+results_cache::results_cache (const char *name) {
+	char *s = getenv ("DAN_RESULTS_CACHE");
+	filename = name ? name : s ? s : "results.txt";
+	FILE *f = fopen (filename.c_str (), "r");
+	if (!f) return;
+	char line[10000];
+	while (fgets (line, sizeof (line), f)) {
+		unsigned long long int k;
+		run_result r;
+		int n;
+		memset (&r, 0, sizeof (r));
+		const char *p = line;
+		if (sscanf (p, "%llx %d %n", &k, &r.ncores, &n) != 2) continue;
+		if (r.ncores < 1 || r.ncores > RUNNER_MAX_CORES) continue;
+		p += n;
+		bool ok = true;
+		for (int i=0; i<r.ncores && ok; i++) {
+			ok = sscanf (p, "%lf %lf %n", &r.ipc[i], &r.mpki[i], &n) == 2;
+			p += n;
+		}
+		if (ok) results[k] = r;
+	}
+	fclose (f);
+}
+
+bool results_cache::lookup (run_job &j) {
+	unsigned long long int k = key (j);
+	lock_guard<mutex> g (lock);
+	map<unsigned long long int, run_result>::iterator p = results.find (k);
+	if (p == results.end () || p->second.ncores != (int) j.traces.size ()) return false;
+	j.result = p->second;
+	j.ok = true;
+	return true;
+}
+
+void results_cache::store (const run_job &j) {
+	if (!j.ok) return;
+	unsigned long long int k = key (j);
+	lock_guard<mutex> g (lock);
+	results[k] = j.result;
+	FILE *f = fopen (filename.c_str (), "a");
+	if (!f) {
+		perror (filename.c_str ());
+		return;
+	}
+	fprintf (f, "%016llx %d", k, j.result.ncores);
+	for (int i=0; i<j.result.ncores; i++) fprintf (f, " %0.6f %0.6f", j.result.ipc[i], j.result.mpki[i]);
+	// the trace names are only there for people reading the file
+	for (size_t i=0; i<j.traces.size(); i++) fprintf (f, " %s", j.traces[i].c_str ());
+	fprintf (f, "\n");
+	fclose (f);
+}
+
+void run_all (std::vector<run_job> &jobs, int njobs, results_cache *cache) {
+	work_pool pool (njobs);
+	for (size_t i=0; i<jobs.size(); i++) {
+		run_job *j = &jobs[i];
+		if (cache && cache->lookup (*j)) continue;
+		pool.submit ([j, cache] () {
+			if (run_one (j) && cache) cache->store (*j);
+		});
+	}
+	pool.wait ();
+}
@@ -0,0 +1,85 @@
+#ifndef __RUNNER_H
+#define __RUNNER_H
+
+// run exclusiu as a child process and scrape its results.
+// the drivers (mix, suite) use this to run many simulations in parallel.
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define RUNNER_MAX_CORES	16
+
+struct run_result {
+	int	ncores;
+	double	ipc[RUNNER_MAX_CORES];
+	double	mpki[RUNNER_MAX_CORES];
+};
+
+// one simulation: a list of trace names (one per core) and extra
+// environment settings like "DAN_POLICY=2" for the child
+
+struct run_job {
+	std::vector<std::string> traces;
+	std::vector<std::string> env;
+	run_result result;
+	bool	ok;
+
+	run_job (void) {
+		ok = false;
+		result.ncores = 0;
+	}
+};
+
+// where to find things; each can be overridden from the environment:
+// DAN_EXCLUSIU (simulator binary), DAN_TRACE_DIR (directory holding
+// <name>.gz traces), DAN_JOBS (number of simulations to run at once)
+
+const char *runner_binary (void);
+std::string runner_trace_path (const std::string &name);
+int runner_jobs (void);
+
+// the value of an environment variable or a default
+
+std::string runner_getenv (const char *name, const char *def);
+
+// read a benchmark list like benchmarks.txt, one name per line
+
+std::vector<std::string> read_benchmark_list (const char *filename);
+
+// run one simulation, blocking until it is done. returns j->ok
+
+bool run_one (run_job *j);
+
+// results of earlier simulations, kept on disk (DAN_RESULTS_CACHE,
+// results.txt by default). a result is keyed by a hash of the traces'
+// resolved paths (so DAN_TRACE_DIR counts), the configuration (every DAN_* setting the child would see,
+// minus the drivers' own), the policy and the simulator binary, so a
+// rebuild never picks up stale results, the LRU baselines' included:
+// changes outside the policies move them too.
+
+class results_cache {
+	std::map<unsigned long long int, run_result> results;
+	std::mutex lock;
+	std::string filename;
+
+public:
+	results_cache (const char *name = NULL);
+
+	static unsigned long long int key (const run_job &j);
+
+	// fill in j from the cache if we can; returns j.ok
+	bool lookup (run_job &j);
+
+	// remember a finished job, appending it to the file
+	void store (const run_job &j);
+};
+
+// run all the jobs using up to njobs concurrent simulations on a
+// work-stealing pool. with a cache, jobs already in it aren't run again
+// and new results are added to it.
+
+void run_all (std::vector<run_job> &jobs, int njobs, results_cache *cache = NULL);
+
+#endif
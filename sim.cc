@@ -0,0 +1,930 @@
+// one simulation: the hierarchy, the traces that drive it and what it reports
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "sim.h"
+#include "model.h"
+#include "profile.h"
+
+// L1 private cache: 64KB
+
+#define L1_CAPACITY	(64 * 1024)
+#define L1_BLOCKSIZE	64
+#define L1_ASSOC	4
+#define L1_NSETS	(L1_CAPACITY/(L1_BLOCKSIZE*L1_ASSOC))
+
+// L2 shared cache: 256KB
+
+#define L2_CAPACITY	(256 * 1024)
+#define L2_BLOCKSIZE	64
+#define L2_ASSOC	8
+#define L2_NSETS	(L2_CAPACITY/(L2_BLOCKSIZE*L2_ASSOC))
+
+// L3 shared cache: 4MB, 16-way unless DAN_LLC_KB and DAN_LLC_ASSOC say
+// otherwise
+
+#ifndef LLC_CAPACITY
+#define LLC_CAPACITY	(4 * 1024 * 1024)
+#endif
+#define LLC_BLOCKSIZE	64
+#define LLC_ASSOC	16
+
+#define GET_PARAM(name,var) { \
+                char *s = getenv (name); \
+                if (!s) { if (0) fprintf (stderr, "warning: parameter %s not found in environment\n", name);} \
+                else { sscanf (s, "%d", &var); fprintf (stderr, "%s=%d\n", name, var); } }
+
+#define GET_LL_PARAM(name,var) { \
+                char *s = getenv (name); \
+                if (!s) { if (0) fprintf (stderr, "warning: parameter %s not found in environment\n", name);} \
+                else { sscanf (s, "%lld", &var); fprintf (stderr, "%s=%lld\n", name, var); } }
+
+static model *find_model (const char *);
+
+sim_config::sim_config (void) {
+	policy = 0;
+	set_shift = 0;
+	warm_inst = 500000000;
+	max_inst = 1000000000;
+	max_cycle = 1;
+	stats_file = NULL;
+	stats_interval = 1000000;
+	lookahead = 8;
+	timing = 0;
+	rob = 192;
+	mshrs = 16;
+	mem_latency = 270;
+	dram = 0;
+	dram_channels = 2;
+	dram_banks = 8;
+	dram_wq_high = 48;
+	dram_wq_low = 16;
+	inclusion = INCLUSION_EXCLUSIVE;
+	llc_capacity = LLC_CAPACITY;
+	llc_assoc = LLC_ASSOC;
+	llc_index = INDEX_MODULO;
+	llc_skew_groups = 4;
+	victim_entries = 0;
+	victim_policy = VICTIM_FIFO;
+	writebuf_entries = 0;
+	writebuf_drain = WRITEBUF_FIFO;
+	miss_profile = 0;
+	miss_profile_region = 12;
+	miss_profile_top = 20;
+	miss_profile_dump = NULL;
+	telemetry_file = NULL;
+	telemetry_stride = 64;
+	telemetry_rate = 1;
+	telemetry_interval = 1000000;
+	pipeline = 0;
+	prefetcher = "none";
+	prefetch_level = 2;
+	prefetch_degree = 2;
+	prefetch_distance = 1;
+	prefetch_low_priority = 1;
+	params_defaults (policy_param_table, policy_param_count, &params);
+}
+
+bool sim_config_from_env (sim_config *cfg) {
+	GET_PARAM ("DAN_POLICY", cfg->policy);
+	GET_LL_PARAM ("DAN_MAX_INST", cfg->max_inst);
+	GET_LL_PARAM ("DAN_MAX_CYCLE", cfg->max_cycle);
+	GET_PARAM ("DAN_WARM_INST", cfg->warm_inst);
+	GET_PARAM ("DAN_SET_SHIFT", cfg->set_shift);
+	GET_PARAM ("DAN_STATS_INTERVAL", cfg->stats_interval);
+	GET_PARAM ("DAN_LOOKAHEAD", cfg->lookahead);
+	GET_PARAM ("DAN_TIMING", cfg->timing);
+	GET_PARAM ("DAN_ROB", cfg->rob);
+	GET_PARAM ("DAN_MSHRS", cfg->mshrs);
+	GET_PARAM ("DAN_MEM_LATENCY", cfg->mem_latency);
+	GET_PARAM ("DAN_DRAM", cfg->dram);
+	if (cfg->dram) {
+		cfg->timing = 1;
+		GET_PARAM ("DAN_DRAM_CHANNELS", cfg->dram_channels);
+		GET_PARAM ("DAN_DRAM_BANKS", cfg->dram_banks);
+		GET_PARAM ("DAN_DRAM_WQ_HIGH", cfg->dram_wq_high);
+		GET_PARAM ("DAN_DRAM_WQ_LOW", cfg->dram_wq_low);
+	}
+	char *s = getenv ("DAN_INCLUSION");
+	if (s) {
+		if (!strcmp (s, "exclusive")) cfg->inclusion = INCLUSION_EXCLUSIVE;
+		else if (!strcmp (s, "inclusive")) cfg->inclusion = INCLUSION_INCLUSIVE;
+		else if (!strcmp (s, "noninclusive")) cfg->inclusion = INCLUSION_NONINCLUSIVE;
+		else {
+			fprintf (stderr, "unknown inclusion policy \"%s\"; use exclusive, inclusive or noninclusive\n", s);
+			return false;
+		}
+		fprintf (stderr, "DAN_INCLUSION=%s\n", s);
+	}
+	int llc_kb = cfg->llc_capacity / 1024;
+	GET_PARAM ("DAN_LLC_KB", llc_kb);
+	GET_PARAM ("DAN_LLC_ASSOC", cfg->llc_assoc);
+	cfg->llc_capacity = llc_kb * 1024ll;
+	long long int llc_sets = cfg->llc_assoc > 0 ? cfg->llc_capacity / (LLC_BLOCKSIZE * cfg->llc_assoc) : 0;
+	if (cfg->llc_assoc < 1 || cfg->llc_assoc > MAX_ASSOC || llc_sets < 1 || llc_sets > MAX_SETS || (llc_sets & (llc_sets - 1)) || llc_sets * LLC_BLOCKSIZE * cfg->llc_assoc != cfg->llc_capacity) {
+		fprintf (stderr, "the LLC needs from 1 to %d ways and a power of two sets, at most %d, of %d-byte blocks\n", MAX_ASSOC, MAX_SETS, LLC_BLOCKSIZE);
+		return false;
+	}
+	s = getenv ("DAN_LLC_INDEX");
+	if (s) {
+		if (!strcmp (s, "modulo")) cfg->llc_index = INDEX_MODULO;
+		else if (!strcmp (s, "xor")) cfg->llc_index = INDEX_XOR;
+		else if (!strcmp (s, "skew")) cfg->llc_index = INDEX_SKEW;
+		else {
+			fprintf (stderr, "unknown index function \"%s\"; use modulo, xor or skew\n", s);
+			return false;
+		}
+		fprintf (stderr, "DAN_LLC_INDEX=%s\n", s);
+		GET_PARAM ("DAN_LLC_SKEW_GROUPS", cfg->llc_skew_groups);
+	}
+	if (cfg->llc_index == INDEX_SKEW && (cfg->llc_skew_groups < 2 || cfg->llc_skew_groups > SKEW_GROUPS_MAX || cfg->llc_assoc % cfg->llc_skew_groups
+		|| (cfg->policy != REPLACEMENT_POLICY_LRU && cfg->policy != REPLACEMENT_POLICY_RANDOM))) {
+		fprintf (stderr, "the skewed LLC needs DAN_POLICY=0 or 1 and DAN_LLC_SKEW_GROUPS from 2 to %d dividing %d\n", SKEW_GROUPS_MAX, cfg->llc_assoc);
+		return false;
+	}
+	GET_PARAM ("DAN_VICTIM_ENTRIES", cfg->victim_entries);
+	if (cfg->victim_entries > VICTIM_MAX_ENTRIES) {
+		fprintf (stderr, "the victim buffer can have at most %d entries\n", VICTIM_MAX_ENTRIES);
+		return false;
+	}
+	s = getenv ("DAN_VICTIM_POLICY");
+	if (s) {
+		if (!strcmp (s, "fifo")) cfg->victim_policy = VICTIM_FIFO;
+		else if (!strcmp (s, "random")) cfg->victim_policy = VICTIM_RANDOM;
+		else {
+			fprintf (stderr, "unknown victim buffer policy \"%s\"; use fifo or random\n", s);
+			return false;
+		}
+		fprintf (stderr, "DAN_VICTIM_POLICY=%s\n", s);
+	}
+	if (cfg->victim_entries > 0 && cfg->inclusion != INCLUSION_EXCLUSIVE) {
+		fprintf (stderr, "the victim buffer needs the exclusive hierarchy\n");
+		return false;
+	}
+	GET_PARAM ("DAN_WRITEBUF_ENTRIES", cfg->writebuf_entries);
+	if (cfg->writebuf_entries > WRITEBUF_MAX_ENTRIES) {
+		fprintf (stderr, "the write buffer can have at most %d entries\n", WRITEBUF_MAX_ENTRIES);
+		return false;
+	}
+	s = getenv ("DAN_WRITEBUF_DRAIN");
+	if (s) {
+		if (!strcmp (s, "fifo")) cfg->writebuf_drain = WRITEBUF_FIFO;
+		else if (!strcmp (s, "lru")) cfg->writebuf_drain = WRITEBUF_LRU;
+		else {
+			fprintf (stderr, "unknown write buffer drain policy \"%s\"; use fifo or lru\n", s);
+			return false;
+		}
+		fprintf (stderr, "DAN_WRITEBUF_DRAIN=%s\n", s);
+	}
+	if (cfg->writebuf_entries > 0 && cfg->inclusion != INCLUSION_EXCLUSIVE) {
+		fprintf (stderr, "the write buffer needs the exclusive hierarchy\n");
+		return false;
+	}
+	GET_PARAM ("DAN_MISS_PROFILE", cfg->miss_profile);
+	if (cfg->miss_profile) {
+		GET_PARAM ("DAN_MISS_PROFILE_REGION", cfg->miss_profile_region);
+		GET_PARAM ("DAN_MISS_PROFILE_TOP", cfg->miss_profile_top);
+		s = getenv ("DAN_MISS_PROFILE_DUMP");
+		if (s) cfg->miss_profile_dump = s;
+		if (cfg->miss_profile_region < 0 || cfg->miss_profile_region > 63) {
+			fprintf (stderr, "DAN_MISS_PROFILE_REGION is the log2 of the region size, from 0 to 63\n");
+			return false;
+		}
+	}
+	s = getenv ("DAN_SET_TELEMETRY");
+	if (s) {
+		cfg->telemetry_file = s;
+		fprintf (stderr, "DAN_SET_TELEMETRY=%s\n", s);
+		GET_PARAM ("DAN_SET_TELEMETRY_STRIDE", cfg->telemetry_stride);
+		GET_PARAM ("DAN_SET_TELEMETRY_RATE", cfg->telemetry_rate);
+		GET_PARAM ("DAN_SET_TELEMETRY_INTERVAL", cfg->telemetry_interval);
+		if (cfg->telemetry_interval <= 0) cfg->telemetry_interval = 1;
+	}
+	s = getenv ("DAN_PREFETCHER");
+	if (s) {
+		GET_PARAM ("DAN_PREFETCH_LEVEL", cfg->prefetch_level);
+		GET_PARAM ("DAN_PREFETCH_DEGREE", cfg->prefetch_degree);
+		GET_PARAM ("DAN_PREFETCH_DISTANCE", cfg->prefetch_distance);
+		GET_PARAM ("DAN_PREFETCH_LOW_PRIORITY", cfg->prefetch_low_priority);
+		prefetcher p;
+		if (!p.configure (s, cfg->prefetch_level, cfg->prefetch_degree, cfg->prefetch_distance)) {
+			fprintf (stderr, "unknown prefetcher \"%s\"; use none, nextline, stride or stream\n", s);
+			return false;
+		}
+		cfg->prefetcher = s;
+		fprintf (stderr, "DAN_PREFETCHER=%s\n", s);
+	}
+	s = getenv ("DAN_STATS_FILE");
+	if (s) cfg->stats_file = s;
+	GET_PARAM ("DAN_PIPELINE", cfg->pipeline);
+	return params_from_env (policy_param_table, policy_param_count, &cfg->params);
+}
+
+simulator::simulator (const sim_config &c, int ntraces, char **names) {
+	int i;
+
+	cfg = c;
+	assert (ntraces >= 1 && ntraces <= MAX_THREADS);
+	nthreads = ncores = ntraces;
+	if (ncores > MAX_CORES) ncores = MAX_CORES;
+	warming = true;
+	iterations = 0;
+	done = false;
+	failed = false;
+	memset (last_insts, 0, sizeof (last_insts));
+	memset (insts_at_warming, 0, sizeof (insts_at_warming));
+	memset (l3_misses, 0, sizeof (l3_misses));
+	memset (l3_misses_at_warming, 0, sizeof (l3_misses_at_warming));
+	memset (hierarchy_at_warming, 0, sizeof (hierarchy_at_warming));
+	memset (&memory_at_warming, 0, sizeof (memory_at_warming));
+	memset (prefetch_at_warming, 0, sizeof (prefetch_at_warming));
+
+	// trace readers
+
+	for (i=0; i<nthreads; i++) {
+		readers[i] = new tracereader (names[i], i);
+		readers[i]->heartbeat = !cfg.stats_file;
+	}
+	if (cfg.lookahead < 0) cfg.lookahead = 0;
+	if (cfg.lookahead > TRACE_WINDOW) cfg.lookahead = TRACE_WINDOW;
+	if (cfg.dram) memory.configure (cfg.dram_channels, cfg.dram_banks, cfg.dram_wq_high, cfg.dram_wq_low);
+	for (i=0; i<MAX_CORES; i++) {
+		prefetchers[i].configure (cfg.prefetcher, cfg.prefetch_level, cfg.prefetch_degree, cfg.prefetch_distance);
+		prefetchers[i].memory_latency = cfg.mem_latency;
+	}
+	prefetching = prefetchers[0].kind != PF_NONE;
+	for (i=0; i<MAX_CORES; i++) {
+		timing[i].rob = cfg.rob;
+		timing[i].mshrs = cfg.mshrs > 0 ? cfg.mshrs : 1;
+	}
+	for (i=0; i<nthreads; i++) {
+		model *m = find_model (readers[i]->getname ());
+		base_cpi[i] = m ? m->b : 0.33333;
+	}
+	if (cfg.stats_interval <= 0) cfg.stats_interval = 1;
+
+	// initialize L1 caches, only for the cores that have a trace
+
+	for (i=0; i<ncores; i++) {
+		init_cache (
+			&L1[i], 	// pointer to L1 cache data structure
+			L1_NSETS, 	// number of sets in L1
+			L1_ASSOC, 	// L1 associativity
+			L1_BLOCKSIZE, 	// L1 cache block size
+			cfg.policy, 	// L1 replacement policy
+			0,
+			&mem);
+
+		// initialize L2 cache
+		init_cache (
+			&L2[i], 		// pointer to L2 cache data structure
+			L2_NSETS, 	// number of sets in L2
+			L2_ASSOC, 	// L2 cache associativity
+			L2_BLOCKSIZE, 	// L2 cache block size
+			cfg.policy, 	// L1 replacement policy
+			0,
+			&mem);
+
+		// an exclusive hierarchy moves every L1 and L2 victim down
+		L1[i].writeback_clean = L2[i].writeback_clean = cfg.inclusion == INCLUSION_EXCLUSIVE;
+
+		// each cache draws random victims from its own generator
+		L1[i].random = xorshift (2 * i + 1);
+		L2[i].random = xorshift (2 * i + 2);
+	}
+
+	int llc_nsets = cfg.llc_capacity / (LLC_BLOCKSIZE * cfg.llc_assoc);
+	printf ("LLC %lld bytes, %d assoc\n", cfg.llc_capacity, cfg.llc_assoc);
+	init_cache (
+		&LLC, 		// pointer to last-level cache data structure
+		llc_nsets, 	// number of sets in last-level cache
+		cfg.llc_assoc, 	// last-level cache associativity
+		LLC_BLOCKSIZE, 	// last-level cache block size
+		cfg.policy, 	// last-level cache replacement policy; 0=lru, 1=rand, etc. as in CRC
+		cfg.set_shift,	// number of lower-order bits in set index to ignore; safe to set to 0 here
+		&mem);
+	LLC.random = xorshift (2 * MAX_CORES + 1);
+	if (!cache_set_index (&LLC, cfg.llc_index, cfg.llc_skew_groups)) {
+		fprintf (stderr, "the skewed LLC needs DAN_POLICY=0 or 1 and DAN_LLC_SKEW_GROUPS from 2 to %d dividing %d\n", SKEW_GROUPS_MAX, cfg.llc_assoc);
+		failed = true;
+	}
+	LLC.inclusion = cfg.inclusion;
+	LLC.sharers = ncores;
+	miss_profile = NULL;
+	if (cfg.miss_profile) {
+		miss_profile = new miss_profiler (cfg.miss_profile_region, cfg.miss_profile_top, cfg.inclusion == INCLUSION_EXCLUSIVE);
+		LLC.profiler = miss_profile;
+	}
+	telemetry = NULL;
+	if (cfg.telemetry_file) {
+		telemetry = new set_telemetry;
+		if (telemetry->open (cfg.telemetry_file, &LLC, cfg.telemetry_stride, cfg.telemetry_rate)) LLC.telemetry = telemetry;
+		else {
+			delete telemetry;
+			telemetry = NULL;
+			failed = true;
+		}
+	}
+	victims = NULL;
+	memset (&victims_at_warming, 0, sizeof (victims_at_warming));
+	if (cfg.victim_entries > 0) {
+		assert (cfg.inclusion == INCLUSION_EXCLUSIVE);
+		victims = new victim_buffer (cfg.victim_entries, cfg.victim_policy, 2 * MAX_CORES + 2, &mem);
+		LLC.victims = victims;
+	}
+	write_buf = NULL;
+	memset (&write_buf_at_warming, 0, sizeof (write_buf_at_warming));
+	if (cfg.writebuf_entries > 0) {
+		assert (cfg.inclusion == INCLUSION_EXCLUSIVE);
+		write_buf = new write_buffer (cfg.writebuf_entries, cfg.writebuf_drain, &mem);
+		LLC.write_buf = write_buf;
+	}
+	for (i=0; i<ncores; i++) {
+		L1[i].repl->SetParams (cfg.params);
+		L2[i].repl->SetParams (cfg.params);
+		L2[i].repl->SetPrefetchInsertion (cfg.prefetch_low_priority);
+	}
+	LLC.repl->SetParams (cfg.params);
+	LLC.repl->SetPrefetchInsertion (cfg.prefetch_low_priority);
+
+	// statistics snapshots go to a JSON-lines file if there is one
+
+	if (cfg.stats_file) init_stats (cfg.stats_file);
+
+	// the pipelined engine, if it can give the same results
+
+	pipelining = false;
+	decoded = NULL;
+	llc_events = NULL;
+	private_stage = llc_stage = NULL;
+	drains = woken = 0;
+	drained = 0;
+	stages_asleep = false;
+	if (cfg.pipeline) {
+		if (cfg.inclusion != INCLUSION_EXCLUSIVE || prefetching || (cfg.dram && nthreads > 1))
+			fprintf (stderr, "the pipeline needs an exclusive hierarchy, no prefetcher, and one trace with DAN_DRAM; running serially\n");
+		else {
+			pipelining = true;
+			decoded = new spsc_ring<pipe_record, PIPE_RING>;
+			llc_events = new spsc_ring<pipe_event, PIPE_RING>;
+		}
+	}
+
+	// prime the traces
+
+	for (i=0; i<nthreads; i++) {
+		traces[i] = readers[i]->read();
+		assert (traces[i]);
+	}
+}
+
+simulator::~simulator (void) {
+	stop_stages ();
+	delete decoded;
+	delete llc_events;
+	delete victims;
+	delete write_buf;
+	delete miss_profile;
+	delete telemetry;
+	for (int i=0; i<nthreads; i++) delete readers[i];
+
+	// the whole hierarchy lives in mem
+
+	for (int i=0; i<MAX_CORES; i++) {
+		free_cache (&L1[i]);
+		free_cache (&L2[i]);
+	}
+	free_cache (&LLC);
+	mem.release ();
+}
+
+void simulator::init_stats (const char *filename) {
+	char name[100];
+	stats.add_cache ("LLC", &LLC.stats, ncores);
+	for (int i=0; i<ncores; i++) {
+		sprintf (name, "L1.%d", i);
+		stats.add_cache (name, &L1[i].stats, MAX_CORES);
+		sprintf (name, "L2.%d", i);
+		stats.add_cache (name, &L2[i].stats, MAX_CORES);
+	}
+	for (int i=0; i<ncores; i++) {
+		sprintf (name, "core%d.instructions", i);
+		stats.add_counter (name, (unsigned long long int *) &last_insts[i]);
+		sprintf (name, "core%d.llc_demand_misses", i);
+		stats.add_counter (name, &l3_misses[i]);
+	}
+	stats.add_counter ("LLC.back_invalidations", &LLC.back_invalidations);
+	stats.add_counter ("LLC.back_invalidations_dirty", &LLC.back_invalidations_dirty);
+	for (int i=0; i<ncores; i++) {
+		sprintf (name, "L2.%d.back_invalidations", i);
+		stats.add_counter (name, &L2[i].back_invalidations);
+		sprintf (name, "L2.%d.back_invalidations_dirty", i);
+		stats.add_counter (name, &L2[i].back_invalidations_dirty);
+	}
+	if (victims) {
+		stats.add_counter ("LLC.victims.lookups", &victims->stats.lookups);
+		stats.add_counter ("LLC.victims.hits", &victims->stats.hits);
+		stats.add_counter ("LLC.victims.dirty_evictions", &victims->stats.dirty_evictions);
+	}
+	if (write_buf) {
+		stats.add_counter ("LLC.write_buf.writes", &write_buf->stats.writes);
+		stats.add_counter ("LLC.write_buf.coalesced", &write_buf->stats.coalesced);
+		stats.add_counter ("LLC.write_buf.hits", &write_buf->stats.hits);
+		stats.add_counter ("LLC.write_buf.drains", &write_buf->stats.drains);
+	}
+	stats.add_gauge ("LLC.valid_lines", [this] () { return (double) cache_occupancy (&LLC, false); });
+	stats.add_gauge ("LLC.dirty_lines", [this] () { return (double) cache_occupancy (&LLC, true); });
+	if (!cfg.params.rwpPerCore) stats.add_gauge ("LLC.rwp.pred_dirty_lines", [this] () { return (double) LLC.repl->GetPredNumDirtyLines (); });
+	else for (int i=0; i<ncores; i++) {
+		// a prediction per core
+		sprintf (name, "LLC.rwp.core%d.pred_dirty_lines", i);
+		stats.add_gauge (name, [this, i] () { return (double) LLC.repl->GetPredNumDirtyLines (i); });
+	}
+	stats.open (filename);
+}
+
+// when thread j's next record happens: its trace cycle, or with the DRAM
+// model, the estimated clock
+
+double simulator::clock_at (int j, unsigned long long int instr) {
+	return instr * base_cpi[j] + timing[j % MAX_CORES].stall ();
+}
+
+double simulator::estimated_clock (int j) {
+	return clock_at (j, traces[j]->instr);
+}
+
+double simulator::core_clock (int j) {
+	if (!cfg.dram) return (double) traces[j]->cycle;
+	return estimated_clock (j);
+}
+
+// thread j went past the warm-up; everything from here on is measured
+
+void simulator::end_warming (int j) {
+	warming = false;
+	fprintf (stderr, "stopped warming at thread %d with %lld instructions...\n", j, last_insts[j]);
+	fflush (stderr);
+	for (int i=0; i<ncores; i++) {
+		l3_misses_at_warming[i] = l3_misses[i];
+		timing_at_warming[i] = timing[i];
+		prefetch_at_warming[i] = prefetchers[i].stats;
+	}
+	hierarchy_counts (hierarchy_at_warming);
+	memory_at_warming = memory.stats;
+	if (victims) victims_at_warming = victims->stats;
+	if (write_buf) write_buf_at_warming = write_buf->stats;
+	if (miss_profile) miss_profile->clear ();
+	if (telemetry) telemetry->recording = true;
+	for (int z=0; z<nthreads; z++) {
+		insts_at_warming[z] = readers[z]->get_icount();
+	}
+}
+
+// put the core ID in the address so we have no coherence issues
+
+static inline unsigned long long int core_address (unsigned long long int address, unsigned int core) {
+	return (address & 0x00ffffffffffffffull) | ((unsigned long long) core << 56);
+}
+
+// get a record ready for the hierarchy
+
+void simulator::prepare (trace *t, unsigned int core) {
+
+	// figure out what kind of operation this is; if it is a
+	// branch then we don't need to know that.  if it is a iread
+	// or dread, or write, then we need it.
+
+	t->address = core_address (t->address, core);
+
+	bool use_br = false;
+	switch (t->cmd) {
+		case DAN_IREAD:
+		case DAN_PREFETCH:
+		case DAN_DREAD:
+		case DAN_WRITEBACK:
+		case DAN_WRITE: break;
+		case DAN_BRTAKEN:
+		case DAN_BRUNTAKEN:
+		case DAN_BRIND:
+			assert (0);
+			use_br = true; break;
+		default: assert (use_br && 0);
+	}
+
+	// since we're simulating an L1 cache, we can't have writebacks
+	// from these traces. so convert writebacks in the traces to writes.
+
+	if (t->cmd == DAN_WRITEBACK) {
+		t->cmd = DAN_WRITE;
+	}
+}
+
+// simulate thread j's current record
+
+void simulator::access (int j) {
+	trace *t = traces[j];
+	unsigned int core = j % MAX_CORES;
+	prepare (t, core);
+
+	// simulate memory access with this trace
+
+	unsigned int miss;
+	unsigned long long int memory_writebacks[MEMORY_WRITEBACKS];
+	prefetcher *pf = NULL;
+	if (prefetching) {
+		pf = &prefetchers[core];
+		pf->now = (unsigned long long int) estimated_clock (j);
+	}
+	miss = memory_access (&L1[0], &L2[0], &LLC, t->address, t->pc, t->size, t->cmd, core, memory_writebacks, pf);
+	account (j, t->instr, t->address, t->cmd, miss, memory_writebacks, pf);
+}
+
+// what an access that came back with these miss bits costs and counts for
+
+void simulator::account (int j, unsigned long long int instr, unsigned long long int address, int cmd, unsigned int miss, const unsigned long long int *memory_writebacks, prefetcher *pf) {
+	unsigned int core = j % MAX_CORES;
+	if (miss & MISS_L3_DEMAND) {
+		if ((cmd != DAN_WRITEBACK) && (cmd != DAN_PREFETCH)) {
+			l3_misses[core]++;
+		}
+	}
+
+	// memory traffic, and what it costs a demand access that had to go all the way out
+
+	unsigned long long int latency = cfg.mem_latency;
+	if (cfg.dram) {
+		unsigned long long int now = (unsigned long long int) clock_at (j, instr);
+		if (miss & MISS_MEMORY_READ) latency = memory.read (address, now);
+		for (int k=0; k<MEMORY_WRITEBACKS; k++) if (memory_writebacks[k]) memory.write (memory_writebacks[k], now);
+
+		// prefetches read memory too, and they are late for as long as the DRAM says
+
+		if (pf) {
+			for (int k=0; k<pf->nreads; k++) pf->set_ready (pf->memory_reads[k], now + memory.read (pf->memory_reads[k], now));
+			for (int k=0; k<pf->nwrites; k++) memory.write (pf->memory_writes[k], now);
+		}
+	}
+	if (cfg.timing && (miss & MISS_MEMORY_READ) && cmd != DAN_PREFETCH)
+		timing[core].miss (instr, latency);
+
+	// a demand access that caught up with its prefetch waits for the rest
+
+	if (cfg.timing && pf && pf->wait)
+		timing[core].miss (instr, pf->wait);
+}
+
+// hand thread j's current record to the pipeline, starting its stages the
+// first time and waking them after a drain
+
+void simulator::issue (int j) {
+	if (!private_stage) {
+		private_stage = new std::thread (&simulator::private_loop, this);
+		llc_stage = new std::thread (&simulator::llc_loop, this);
+	} else if (stages_asleep) {
+		std::lock_guard<std::mutex> g (stage_lock);
+		woken = drains;
+		stages_asleep = false;
+		stage_wake.notify_all ();
+	}
+	pipe_record r;
+	r.t = *traces[j];
+	r.thread = j;
+	prepare (&r.t, j % MAX_CORES);
+	decoded->push (r);
+}
+
+// wait for everything issued to get through the pipeline
+
+void simulator::drain (void) {
+	if (!private_stage || stages_asleep) return;
+	pipe_record r;
+	r.thread = PIPE_DRAIN;
+	decoded->push (r);
+	drains++;
+	while (drained.load (std::memory_order_acquire) != drains) std::this_thread::yield ();
+	stages_asleep = true;
+}
+
+// end the stages for good
+
+void simulator::stop_stages (void) {
+	if (!private_stage) return;
+	{
+		std::lock_guard<std::mutex> g (stage_lock);
+		woken = drains;
+		stages_asleep = false;
+		stage_wake.notify_all ();
+	}
+	pipe_record r;
+	r.thread = PIPE_STOP;
+	decoded->push (r);
+	private_stage->join ();
+	llc_stage->join ();
+	delete private_stage;
+	delete llc_stage;
+	private_stage = llc_stage = NULL;
+}
+
+// a stage after its marker'th drain marker, until issue or stop_stages
+// lets it go on
+
+void simulator::stage_sleep (unsigned long long int marker) {
+	std::unique_lock<std::mutex> g (stage_lock);
+	stage_wake.wait (g, [this, marker] () { return woken >= marker; });
+}
+
+// the private levels' stage: each core's L1 and L2
+
+void simulator::private_loop (void) {
+	pipe_record r;
+	pipe_event e;
+	unsigned long long int markers = 0;
+	for (;;) {
+		decoded->pop (&r);
+		if (r.thread == PIPE_STOP) break;
+		if (r.thread == PIPE_DRAIN) {
+			prof_flush ();
+			e.thread = PIPE_DRAIN;
+			llc_events->push (e);
+			stage_sleep (++markers);
+			continue;
+		}
+
+		// the sets a record a few after this one will use
+
+		if (cfg.lookahead) {
+			const pipe_record *a = decoded->peek (cfg.lookahead - 1);
+			if (a && a->thread >= 0) {
+				cache_prefetch_set (&L1[a->thread % MAX_CORES], a->t.address);
+				cache_prefetch_set (&L2[a->thread % MAX_CORES], a->t.address);
+			}
+		}
+		e.thread = r.thread;
+		e.instr = r.t.instr;
+		e.miss = private_access (&L1[0], &L2[0], r.t.address, r.t.pc, r.t.size, r.t.cmd, r.thread % MAX_CORES, &e.req);
+		llc_events->push (e);
+	}
+	e.thread = PIPE_STOP;
+	llc_events->push (e);
+	prof_flush ();
+}
+
+// the LLC's stage, with the memory and timing models behind it
+
+void simulator::llc_loop (void) {
+	pipe_event e;
+	unsigned long long int memory_writebacks[MEMORY_WRITEBACKS];
+	unsigned long long int markers = 0;
+	for (;;) {
+		llc_events->pop (&e);
+		if (e.thread == PIPE_STOP) break;
+		if (e.thread == PIPE_DRAIN) {
+			prof_flush ();
+			drained.store (++markers, std::memory_order_release);
+			stage_sleep (markers);
+			continue;
+		}
+		if (cfg.lookahead) {
+			const pipe_event *a = llc_events->peek (cfg.lookahead - 1);
+			if (a && a->thread >= 0) {
+				if (a->req.probe) cache_prefetch_set (&LLC, a->req.address);
+				if (a->req.victim) cache_prefetch_set (&LLC, a->req.victim);
+			}
+		}
+		for (int k=0; k<MEMORY_WRITEBACKS; k++) memory_writebacks[k] = 0;
+		unsigned int miss = e.miss | llc_access (&LLC, &e.req, memory_writebacks);
+		PROF_COUNT_PATH (miss);
+		account (e.thread, e.instr, e.req.address, e.req.op, miss, memory_writebacks, NULL);
+	}
+	prof_flush ();
+}
+
+bool simulator::step (long long int n) {
+
+	// read a lot of traces
+	// currently, the trace reader just sets the number of cycles equal to the number of instructions in that thread.
+	// after the simulation is done we translate this to estimated cycles using misses and a linear model.
+
+	for (long long int steps=0; !done && steps<n; steps++) {
+
+		// see which trace comes first in terms of cycle count (i.e. instruction count for now)
+
+		int min_cycle_thread = -1;
+		for (int j=0; j<nthreads; j++) {
+			if (min_cycle_thread == -1) {
+				if (traces[j]) min_cycle_thread = j;
+			} else {
+				if (traces[j] && (core_clock (j) < core_clock (min_cycle_thread))) min_cycle_thread = j;
+			}
+			last_insts[j] = traces[j]->instr;// readers[j]->get_icount();
+			if (warming && last_insts[j] > cfg.warm_inst) {
+				drain ();
+				end_warming (j);
+			}
+		}
+		// all traces have been read, we're done
+
+		if (min_cycle_thread == -1) {
+			fprintf (stderr, "all done\n");
+			for (int i=0; i<ncores; i++) printf ("icount core %d: %lld\n", i, readers[i]->get_icount());
+			done = true;
+			break;
+		}
+
+		// the oldest trace
+
+		if (pipelining) issue (min_cycle_thread);
+		else access (min_cycle_thread);
+
+		// replace the oldest trace with a new trace from the same trace file
+
+		if (traces[min_cycle_thread]) {
+			traces[min_cycle_thread] = readers[min_cycle_thread]->read();
+
+			// the sets a record a few ahead in this thread will use. it
+			// hasn't been prepared yet, and the core ID goes into the
+			// hashed set indexes
+
+			if (cfg.lookahead && !pipelining) {
+				unsigned int core = min_cycle_thread % MAX_CORES;
+				memory_prefetch (&L1[0], &L2[0], &LLC, core_address (readers[min_cycle_thread]->peek (cfg.lookahead)->address, core), core);
+			}
+		}
+		// the progress report, unless the snapshots are taking its place
+
+		if (iterations && iterations % 100000000 == 0 && !cfg.stats_file) {
+			printf ("core 0 icount = %lld\n", readers[0]->get_icount());
+			drain ();
+			print_stats ();
+		}
+		iterations++;
+		if (iterations % cfg.stats_interval == 0 && stats.active ()) {
+			drain ();
+			stats.snapshot_now (iterations);
+		}
+		if (telemetry && iterations % cfg.telemetry_interval == 0 && !warming) {
+			drain ();
+			telemetry->end_interval (&LLC, iterations);
+		}
+
+		// see if we are done in terms of getting to the maximum number of instructions for some thread
+
+		bool done_cycle = false;
+		bool done_inst = false;
+		// all threads must have executed at least this many cycles or we're not done,
+		// or at least one thread must have executed at least this many instructions or we're not done
+		for (int j=0; j<nthreads; j++) {
+			if (readers[j]->get_cycles() < cfg.max_cycle) {
+				done_cycle = false;
+			}
+			if (readers[j]->get_icount() >= cfg.max_inst) {
+				printf ("thread %d reached %lld instructions; stopping\n", j, readers[j]->get_icount());
+				done_inst = true;
+			}
+		}
+		if (done_cycle) {
+			printf ("all threads have reached at least %lld cycles; stopping\n", cfg.max_cycle);
+			done = true;
+		}
+		if (done_inst) done = true;
+	}
+	drain ();
+	return !done;
+}
+
+void simulator::finish (void) {
+	print_stats ();
+	if (miss_profile) {
+		miss_profile->report (stdout);
+		if (cfg.miss_profile_dump) miss_profile->dump (cfg.miss_profile_dump);
+		fflush (stdout);
+	}
+	if (telemetry) {
+		telemetry->report (stdout);
+		telemetry->close ();
+		fflush (stdout);
+	}
+	stats.snapshot_now (iterations);
+	stats.close ();
+}
+
+unsigned long long int simulator::instructions (int i) {
+	return last_insts[i] - insts_at_warming[i];
+}
+
+unsigned long long int simulator::llc_misses (int i) {
+	return l3_misses[i] - l3_misses_at_warming[i];
+}
+
+double simulator::mpki (int i) {
+	return 1000.0 * llc_misses (i) / (double) instructions (i);
+}
+
+double simulator::ipc (int i) {
+	model *m = find_model (readers[i]->getname ());
+	double cpi;
+	if (!m) {
+		fprintf (stderr, "no model! defaulting to stupid model.\n");
+#define L3_MISS_PENALTY	270
+		cpi = ( L3_MISS_PENALTY * (llc_misses (i) / (double) instructions (i)) ) + 0.33333;
+	} else {
+		double mpki = 1000.0 * (llc_misses (i) / (double) instructions (i));
+		cpi = mpki * m->m + m->b;
+	}
+	return 1 / cpi;
+}
+
+void simulator::print_stats (void) {
+	int i;
+
+	LLC.repl->PrintStats (cout);
+
+	// compute estimated MPKIs
+
+	char hostname[100];
+	gethostname (hostname, 100);
+	printf ("hostname %s\n", hostname);
+	fflush (stdout);
+
+	// printf ("L3 counts: %lld %lld %lld %lld ", LLC.counts[0], LLC.counts[1], LLC.counts[2], LLC.counts[6]);
+	printf ("L3 instructions: ");
+	for (i=0; i<ncores; i++) printf ("core %d: %lld ", i, instructions (i));
+	printf ("\nL3 misses: ");
+	for (i=0; i<ncores; i++) printf ("core %d: %lld ", i, llc_misses (i));
+	printf ("\nL3 mpki: ");
+	for (i=0; i<ncores; i++) printf ("core %d: %0.4f ", i, mpki (i));
+	printf ("\n");
+	if (!warming) for (i=0; i<ncores; i++) {
+		printf ("core %d: %0.4f IPC\n", i, ipc (i));
+		if (cfg.timing) {
+			model *m = find_model (readers[i]->getname ());
+			interval_model *now = &timing[i], *then = &timing_at_warming[i];
+			double insts = (double) instructions (i);
+			unsigned long long int misses = now->misses - then->misses, intervals = now->intervals - then->intervals;
+			double icpi = (m ? m->b : 0.33333) + (now->stall () - then->stall ()) / insts;
+			printf ("interval core %d: %0.4f IPC, %0.4f CPI, %lld misses in %lld intervals, MLP %0.2f\n",
+				i, 1 / icpi, icpi, misses, intervals, intervals ? (double) misses / intervals : 0.0);
+		}
+		printf ("LLC invalidations: %lld\n", LLC.invalidations);
+	}
+	if (cfg.inclusion != INCLUSION_EXCLUSIVE && !warming) {
+		unsigned long long int c[HIERARCHY_COUNTS];
+		hierarchy_counts (c);
+		for (i=0; i<HIERARCHY_COUNTS; i++) c[i] -= hierarchy_at_warming[i];
+		printf ("%s hierarchy: back-invalidations from L2 %lld (%lld dirty), from LLC %lld (%lld dirty); dirty victims written back from L1 %lld, L2 %lld, LLC %lld\n",
+			cfg.inclusion == INCLUSION_INCLUSIVE ? "inclusive" : "non-inclusive", c[0], c[1], c[2], c[3], c[4], c[5], c[6]);
+	}
+	if (prefetching && !warming) for (i=0; i<ncores; i++) prefetchers[i].report (stdout, i, &prefetch_at_warming[i]);
+	if (victims && !warming) victims->report (stdout, &victims_at_warming);
+	if (write_buf && !warming) write_buf->report (stdout, &write_buf_at_warming);
+	if (!warming) {
+		// how often a hit was in the way its set tried first, over the whole run
+		unsigned long long int right[3] = { 0, 0, LLC.way_predicted }, wrong[3] = { 0, 0, LLC.way_mispredicted };
+		for (i=0; i<ncores; i++) {
+			right[0] += L1[i].way_predicted;
+			wrong[0] += L1[i].way_mispredicted;
+			right[1] += L2[i].way_predicted;
+			wrong[1] += L2[i].way_mispredicted;
+		}
+		printf ("way prediction: hits in the predicted way");
+		for (i=0; i<3; i++) printf (" %s %0.4f of %lld%s", i == 2 ? "LLC" : i ? "L2" : "L1",
+			right[i] + wrong[i] ? (double) right[i] / (right[i] + wrong[i]) : 0.0, right[i] + wrong[i], i < 2 ? "," : "");
+		printf ("\n");
+	}
+	if (cfg.dram && !warming) memory.report (stdout, &memory_at_warming, memory.stats.last_cycle - memory_at_warming.last_cycle);
+	fflush (stdout);
+}
+
+// the linear model for a trace, or NULL if there isn't one
+
+static model *find_model (const char *name) {
+	for (int j=0; models[j].name; j++) {
+		if (strstr (name, models[j].name)) return &models[j];
+	}
+	return NULL;
+}
+
+// back-invalidations from the L2s (all, dirty) and the LLC (all, dirty),
+// then victims written back from the L1s, L2s and LLC
+
+void simulator::hierarchy_counts (unsigned long long int *c) {
+	memset (c, 0, HIERARCHY_COUNTS * sizeof (*c));
+	for (int i=0; i<ncores; i++) {
+		c[0] += L2[i].back_invalidations;
+		c[1] += L2[i].back_invalidations_dirty;
+		for (int src=0; src<STATS_MAX_SOURCES; src++) {
+			c[4] += L1[i].stats.by_source[STAT_WRITEBACK][src];
+			c[5] += L2[i].stats.by_source[STAT_WRITEBACK][src];
+		}
+	}
+	c[2] = LLC.back_invalidations;
+	c[3] = LLC.back_invalidations_dirty;
+	for (int src=0; src<STATS_MAX_SOURCES; src++) c[6] += LLC.stats.by_source[STAT_WRITEBACK][src];
+}
@@ -0,0 +1,204 @@
+#ifndef __SIM_H
+#define __SIM_H
+
+// the simulator as a library. a simulator owns everything one run needs:
+// the hierarchy (private L1 and L2 per core, shared LLC), the trace
+// readers, the timing, DRAM and prefetcher models and its statistics, so
+// several can run in one process, each on its own thread. construct one
+// from a sim_config (sim_config_from_env reads the DAN_* variables
+// exclusiu has always taken), check ok, call step until it returns
+// false, then finish to print the report. nothing in here exits the
+// process: a simulator that couldn't be set up says why on stderr and
+// isn't ok, and only wants deleting. everything a simulator allocates for its
+// caches and buffers comes from an arena of its own, which its destructor
+// releases. the hot path profiler (profile.h) keeps its counts per
+// thread and adds them up for the report, so with several simulators it
+// covers all of them.
+//
+// with pipeline set (DAN_PIPELINE=1), step runs the exclusive hierarchy as
+// three stages on three threads: reading and decoding the traces, each
+// core's L1 and L2 (private_access), and the LLC with the memory and
+// timing models (llc_access and the accounting after it), connected by
+// ring buffers. the private levels never depend on the LLC, and each stage
+// sees its events in the serial order, so the results are the same. the
+// stage threads start with the first record and last as long as the
+// simulator; whenever the statistics are looked at the stages drain, and
+// they sleep until the next record. it needs the
+// exclusive hierarchy and no prefetcher, and with the DRAM model only one
+// trace, since then the cores' interleaving depends on LLC misses.
+
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "utils.h"
+#include "replacement_state.h"
+#include "stats.h"
+#include "arena.h"
+#include "cache.h"
+#include "trace.h"
+#include "timing.h"
+#include "dram.h"
+#include "prefetch.h"
+#include "victim.h"
+#include "writebuf.h"
+#include "missprof.h"
+#include "telemetry.h"
+#include "ring.h"
+
+#define MAX_CORES	16
+#define MAX_THREADS	256
+#define PIPE_RING	1024	// records or events between two stages
+#define PIPE_STOP	(-1)	// the thread of a record that ends the stages
+#define PIPE_DRAIN	(-2)	// and of one that drains them
+
+struct sim_config {
+	int policy, set_shift, warm_inst;
+	unsigned long long int max_inst, max_cycle;
+	const char *stats_file;		// JSON-lines snapshots, or NULL
+	int stats_interval;
+	int lookahead;
+	int timing, rob, mshrs, mem_latency;
+	int dram, dram_channels, dram_banks, dram_wq_high, dram_wq_low;
+	int inclusion;
+	long long int llc_capacity;	// bytes
+	int llc_assoc;
+	int llc_index, llc_skew_groups;	// the LLC's index function, INDEX_*
+	int victim_entries, victim_policy;	// the LLC's victim buffer, if entries > 0
+	int writebuf_entries, writebuf_drain;	// the write-combining buffer above the LLC, if entries > 0
+	int miss_profile, miss_profile_region, miss_profile_top;
+	const char *miss_profile_dump;	// binary dump of the miss profile, or NULL
+	const char *telemetry_file;	// per-set telemetry, or NULL
+	int telemetry_stride, telemetry_rate, telemetry_interval;
+	int pipeline;
+	const char *prefetcher;		// "none", "nextline", "stride" or "stream"
+	int prefetch_level, prefetch_degree, prefetch_distance, prefetch_low_priority;
+	policy_params params;		// the replacement policies' tunables, params.h
+
+	sim_config (void);
+};
+
+// override the defaults with whatever DAN_* variables are set; returns
+// false and says why on stderr if one of them is no good
+bool sim_config_from_env (sim_config *cfg);
+
+// back-invalidations and writebacks for the inclusive and non-inclusive
+// hierarchies; the exclusive one's invalidations are the LLC's own
+#define HIERARCHY_COUNTS	7
+
+class simulator {
+	sim_config cfg;
+	int ncores, nthreads;
+	bool warming, prefetching;
+
+	arena mem;	// the caches' sets and replacement state and the buffers'
+	cache L1[MAX_CORES], L2[MAX_CORES], LLC;
+	tracereader *readers[MAX_THREADS];
+	trace *traces[MAX_THREADS];
+	long long int last_insts[MAX_THREADS];
+	unsigned long long int insts_at_warming[MAX_THREADS];
+	unsigned long long int l3_misses[MAX_CORES], l3_misses_at_warming[MAX_CORES];
+
+	interval_model timing[MAX_CORES], timing_at_warming[MAX_CORES];
+
+	// with the DRAM model each core keeps an estimated clock,
+	// instructions times the base CPI plus the interval model's stalls,
+	// and the cores are interleaved by that clock instead of trace
+	// cycles. that way a core that is waiting on memory issues requests
+	// more slowly.
+	double base_cpi[MAX_THREADS];
+	dram memory;
+	dram_stats memory_at_warming;
+
+	prefetcher prefetchers[MAX_CORES];
+	prefetch_stats prefetch_at_warming[MAX_CORES];
+
+	unsigned long long int hierarchy_at_warming[HIERARCHY_COUNTS];
+
+	victim_buffer *victims;
+	victim_stats victims_at_warming;
+
+	write_buffer *write_buf;	// the LLC's, or NULL
+	writebuf_stats write_buf_at_warming;
+
+	miss_profiler *miss_profile;	// the LLC's, or NULL
+	set_telemetry *telemetry;	// the LLC's, or NULL
+
+	// periodic snapshots of the statistics, written by a background thread
+	stats_registry stats;
+
+	// the pipelined engine's stages and the queues between them. a
+	// PIPE_DRAIN record goes down both stages, and the LLC stage counts it
+	// in drained once everything before it is done; after one the stages
+	// wait for woken to catch up with the markers they have seen. a
+	// PIPE_STOP record ends them
+	struct pipe_record {
+		trace t;
+		int thread;
+	};
+	struct pipe_event {
+		llc_request req;
+		unsigned int miss;
+		unsigned long long int instr;
+		int thread;
+	};
+	bool pipelining;
+	spsc_ring<pipe_record, PIPE_RING> *decoded;
+	spsc_ring<pipe_event, PIPE_RING> *llc_events;
+	std::thread *private_stage, *llc_stage;
+	unsigned long long int drains;		// markers issued
+	std::atomic<unsigned long long int> drained;
+	unsigned long long int woken;		// markers the stages may go past
+	bool stages_asleep;
+	std::mutex stage_lock;
+	std::condition_variable stage_wake;
+
+	void issue (int thread);
+	void drain (void);
+	void stop_stages (void);
+	void stage_sleep (unsigned long long int marker);
+	void private_loop (void);
+	void llc_loop (void);
+
+	void init_stats (const char *filename);
+	void hierarchy_counts (unsigned long long int *c);
+	void end_warming (int thread);
+	void prepare (trace *t, unsigned int core);
+	void access (int thread);
+	void account (int thread, unsigned long long int instr, unsigned long long int address, int cmd, unsigned int miss, const unsigned long long int *memory_writebacks, prefetcher *pf);
+	double clock_at (int thread, unsigned long long int instr);
+	double estimated_clock (int thread);
+	double core_clock (int thread);
+
+	bool failed;	// see ok
+
+public:
+	long long int iterations;	// trace records simulated
+	bool done;
+
+	// one trace per thread; thread j runs on core j % MAX_CORES
+	simulator (const sim_config &cfg, int ntraces, char **names);
+	~simulator (void);
+
+	// false if the configuration couldn't be set up
+	bool ok (void) { return !failed; }
+
+	// simulate up to n more trace records; returns false once the run
+	// has reached its instruction limit or run out of traces
+	bool step (long long int n);
+
+	// print the report so far, and the final one with the last snapshot
+	void print_stats (void);
+	void finish (void);
+
+	// results since the end of warming
+	int cores (void) { return ncores; }
+	unsigned long long int instructions (int core);
+	unsigned long long int llc_misses (int core);
+	double mpki (int core);
+	double ipc (int core);		// from the benchmark's linear model
+	unsigned long long int llc_accesses (void) { return LLC.accesses; }
+};
+
+#endif
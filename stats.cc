@@ -0,0 +1,122 @@
+// statistics registry and the background thread that writes snapshots
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "stats.h"
+
+using namespace std;
+
+const char *stat_names[STAT_MAX] = { "hit", "miss", "fill", "bypass", "writeback", "invalidate" };
+
+// AccessTypes, lower case; the two unsupported types are never reported
+
+static const char *type_names[STATS_MAX_TYPES] = { "ifetch", "load", "store", NULL, NULL, "prefetch", "writeback" };
+
+stats_registry::stats_registry (void) {
+	stopping = false;
+	fp = NULL;
+}
+
+stats_registry::~stats_registry (void) {
+	close ();
+}
+
+bool stats_registry::open (const char *filename) {
+	fp = fopen (filename, "w");
+	if (!fp) {
+		perror (filename);
+		return false;
+	}
+
+	// the first line names the counters and gauges; every snapshot after
+	// that is just the values in the same order
+
+	fprintf (fp, "{\"counters\":[");
+	for (size_t i=0; i<counters.size(); i++) fprintf (fp, "%s\"%s\"", i ? "," : "", counters[i].name.c_str ());
+	fprintf (fp, "],\"gauges\":[");
+	for (size_t i=0; i<gauges.size(); i++) fprintf (fp, "%s\"%s\"", i ? "," : "", gauges[i].name.c_str ());
+	fprintf (fp, "]}\n");
+	writer = thread (&stats_registry::write_loop, this);
+	return true;
+}
+
+void stats_registry::add_counter (const string &name, const unsigned long long int *p) {
+	assert (!fp); // the schema has already been written
+	counter c;
+	c.name = name;
+	c.p = p;
+	counters.push_back (c);
+}
+
+void stats_registry::add_gauge (const string &name, function<double()> f) {
+	assert (!fp);
+	gauge g;
+	g.name = name;
+	g.f = f;
+	gauges.push_back (g);
+}
+
+void stats_registry::add_cache (const string &name, const cache_stats *s, int cores) {
+	char buf[1000];
+	for (int c=0; c<cores && c<STATS_MAX_CORES; c++)
+		for (int e=0; e<STAT_MAX; e++)
+			for (int t=0; t<STATS_MAX_TYPES; t++) {
+				if (!type_names[t]) continue;
+				sprintf (buf, "%s.core%d.%s.%s", name.c_str (), c, stat_names[e], type_names[t]);
+				add_counter (buf, &s->by_type[c][e][t]);
+			}
+	for (int e=0; e<STAT_MAX; e++)
+		for (int src=0; src<STATS_MAX_SOURCES; src++) {
+			sprintf (buf, "%s.source%d.%s", name.c_str (), src, stat_names[e]);
+			add_counter (buf, &s->by_source[e][src]);
+		}
+	for (int i=0; i<STATS_MAX_POSITIONS; i++) {
+		sprintf (buf, "%s.hit_position.%d", name.c_str (), i);
+		add_counter (buf, &s->hit_position[i]);
+	}
+}
+
+void stats_registry::snapshot_now (unsigned long long int t) {
+	if (!fp) return;
+	snapshot *s = new snapshot;
+	s->t = t;
+	s->counters.resize (counters.size ());
+	for (size_t i=0; i<counters.size(); i++) s->counters[i] = *counters[i].p;
+	s->gauges.resize (gauges.size ());
+	for (size_t i=0; i<gauges.size(); i++) s->gauges[i] = gauges[i].f ();
+	lock_guard<mutex> g (lock);
+	queue.push_back (s);
+	ready.notify_one ();
+}
+
+void stats_registry::write_loop (void) {
+	for (;;) {
+		snapshot *s;
+		{
+			unique_lock<mutex> g (lock);
+			while (queue.empty () && !stopping) ready.wait (g);
+			if (queue.empty ()) return;
+			s = queue.front ();
+			queue.pop_front ();
+		}
+		fprintf (fp, "{\"t\":%llu,\"counters\":[", s->t);
+		for (size_t i=0; i<s->counters.size(); i++) fprintf (fp, "%s%llu", i ? "," : "", s->counters[i]);
+		fprintf (fp, "],\"gauges\":[");
+		for (size_t i=0; i<s->gauges.size(); i++) fprintf (fp, "%s%g", i ? "," : "", s->gauges[i]);
+		fprintf (fp, "]}\n");
+		delete s;
+	}
+}
+
+void stats_registry::close (void) {
+	if (!fp) return;
+	{
+		lock_guard<mutex> g (lock);
+		stopping = true;
+		ready.notify_one ();
+	}
+	writer.join ();
+	fclose (fp);
+	fp = NULL;
+}
@@ -0,0 +1,110 @@
+#ifndef __STATS_H
+#define __STATS_H
+
+// structured statistics. each cache keeps plain counters that the
+// simulation thread bumps on the hot path; a stats_registry knows where
+// all of them live and, every so often, copies them into a snapshot that
+// a background thread writes out as one line of JSON. the simulation
+// thread only ever does the copy, never any I/O.
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+// events counted per cache
+
+#define STAT_HIT	0
+#define STAT_MISS	1
+#define STAT_FILL	2	// a block was placed
+#define STAT_BYPASS	3	// the policy declined to place a block
+#define STAT_WRITEBACK	4	// a victim was sent to the next level
+#define STAT_INVALIDATE	5	// a block was invalidated out of this cache
+#define STAT_MAX	6
+
+#define STATS_MAX_CORES		16
+#define STATS_MAX_SOURCES	9	// access_source values, ACCESS_1 through ACCESS_8
+#define STATS_MAX_TYPES		7	// AccessTypes, ACCESS_IFETCH through ACCESS_WRITEBACK
+#define STATS_MAX_POSITIONS	16	// buckets for the hit position histogram
+
+extern const char *stat_names[STAT_MAX];
+
+struct cache_stats {
+	// by requesting core, event and access type
+	unsigned long long int by_type[STATS_MAX_CORES][STAT_MAX][STATS_MAX_TYPES];
+
+	// by event and where in the hierarchy the access came from
+	unsigned long long int by_source[STAT_MAX][STATS_MAX_SOURCES];
+
+	// histogram of recency stack positions of hits; 0 is MRU
+	unsigned long long int hit_position[STATS_MAX_POSITIONS];
+
+	cache_stats (void) {
+		memset (this, 0, sizeof (*this));
+	}
+
+	void count (int event, unsigned int core, int type, int source) {
+		by_type[core % STATS_MAX_CORES][event][type]++;
+		by_source[event][source]++;
+	}
+};
+
+class stats_registry {
+	struct counter {
+		std::string name;
+		const unsigned long long int *p;
+	};
+	struct gauge {
+		std::string name;
+		std::function<double()> f;
+	};
+	struct snapshot {
+		unsigned long long int t;
+		std::vector<unsigned long long int> counters;
+		std::vector<double> gauges;
+	};
+
+	std::vector<counter> counters;
+	std::vector<gauge> gauges;
+
+	// snapshots waiting for the writer thread
+	std::deque<snapshot *> queue;
+	std::mutex lock;
+	std::condition_variable ready;
+	std::thread writer;
+	bool stopping;
+	FILE *fp;
+
+	void write_loop (void);
+
+public:
+	stats_registry (void);
+	~stats_registry (void);
+
+	// start writing snapshots to a file; returns false if it can't be opened
+	bool open (const char *filename);
+	bool active (void) { return fp != NULL; }
+
+	// counters are read straight from memory at snapshot time. gauges
+	// are computed by a callback, also on the simulation thread.
+	void add_counter (const std::string &name, const unsigned long long int *p);
+	void add_gauge (const std::string &name, std::function<double()> f);
+
+	// register everything in a cache_stats; cores says how many cores'
+	// worth of by_type counters are worth reporting
+	void add_cache (const std::string &name, const cache_stats *s, int cores);
+
+	// copy every counter and gauge and hand them to the writer. t is
+	// whatever the caller uses as time, e.g. trace records simulated.
+	void snapshot_now (unsigned long long int t);
+
+	// write out everything queued and stop the writer
+	void close (void);
+};
+
+#endif
@@ -0,0 +1,93 @@
+// suite: run every benchmark in a list under a baseline policy and one or
+// more policies under test, and report each policy's IPC speedup over the
+// baseline per benchmark plus the geometric mean, which is the metric in
+// the README.
+//
+// usage: suite [-l benchmark-list] [-b baseline-policy] [policy ...]
+//
+// the benchmark list defaults to benchmarks.txt, the baseline to 0 (LRU)
+// and the policies to 2. all the simulations go to a work-stealing pool
+// with DAN_JOBS workers (one per processor by default), and results are
+// kept in the results cache so baselines are only simulated once per
+// trace and configuration.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include "runner.h"
+
+using namespace std;
+
+int main (int argc, char *argv[]) {
+	const char *listname = "benchmarks.txt";
+	string baseline = "0";
+	int c;
+	while ((c = getopt (argc, argv, "l:b:")) != -1) {
+		switch (c) {
+		case 'l': listname = optarg; break;
+		case 'b': baseline = optarg; break;
+		default:
+			fprintf (stderr, "usage: %s [-l benchmark-list] [-b baseline-policy] [policy ...]\n", argv[0]);
+			return 1;
+		}
+	}
+	vector<string> policies;
+	policies.push_back (baseline);
+	for (int i=optind; i<argc; i++) policies.push_back (argv[i]);
+	if (policies.size () == 1) policies.push_back ("2");
+	vector<string> bench = read_benchmark_list (listname);
+	if (bench.empty ()) {
+		fprintf (stderr, "no benchmarks in %s\n", listname);
+		return 1;
+	}
+
+	// jobs[b * npolicies + p] is benchmark b under policy p
+
+	int np = (int) policies.size ();
+	vector<run_job> jobs (bench.size () * np);
+	for (size_t b=0; b<bench.size(); b++) {
+		for (int p=0; p<np; p++) {
+			run_job &j = jobs[b * np + p];
+			j.traces.push_back (bench[b]);
+			j.env.push_back ("DAN_POLICY=" + policies[p]);
+		}
+	}
+	results_cache cache;
+	run_all (jobs, runner_jobs (), &cache);
+
+	printf ("%-24s %10s", "benchmark", ("IPC(" + policies[0] + ")").c_str ());
+	for (int p=1; p<np; p++) printf (" %10s %10s", ("IPC(" + policies[p] + ")").c_str (), "speedup");
+	printf ("\n");
+	vector<double> logsum (np, 0.0);
+	vector<int> count (np, 0);
+	bool failed = false;
+	for (size_t b=0; b<bench.size(); b++) {
+		run_job &base = jobs[b * np];
+		printf ("%-24s", bench[b].c_str ());
+		if (base.ok) printf (" %10.4f", base.result.ipc[0]); else printf (" %10s", "-");
+		for (int p=1; p<np; p++) {
+			run_job &j = jobs[b * np + p];
+			if (!j.ok || !base.ok || base.result.ipc[0] <= 0) {
+				printf (" %10s %10s", j.ok ? "" : "-", "-");
+				failed = true;
+				continue;
+			}
+			double speedup = j.result.ipc[0] / base.result.ipc[0];
+			printf (" %10.4f %10.4f", j.result.ipc[0], speedup);
+			logsum[p] += log (speedup);
+			count[p]++;
+		}
+		printf ("\n");
+	}
+	printf ("%-24s %10s", "geomean", "");
+	for (int p=1; p<np; p++) {
+		if (count[p]) printf (" %10s %10.4f", "", exp (logsum[p] / count[p]));
+		else printf (" %10s %10s", "", "-");
+	}
+	printf ("\n");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,206 @@
+// synthetic trace source
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "utils.h"
+#include "replacement_state.h"
+#include "stats.h"
+#include "cache.h"
+#include "trace.h"
+#include "synth.h"
+
+using namespace std;
+
+synth::synth (unsigned long long int seed) {
+	nphases = 0;
+	current = 0;
+	phase_length = 100000000ull;
+	phase_start = 0;
+	state = seed ? seed : 1;
+	instr = 0;
+	stream_pos = 0;
+	chase_pos = 0;
+}
+
+// xorshift64*
+
+unsigned long long int synth::next_random (void) {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 0x2545f4914f6cdd1dull;
+}
+
+// a number with an optional K, M or G suffix
+
+static unsigned long long int parse_size (const char *s) {
+	char *end;
+	unsigned long long int n = strtoull (s, &end, 0);
+	switch (*end) {
+	case 'k': case 'K': n <<= 10; break;
+	case 'm': case 'M': n <<= 20; break;
+	case 'g': case 'G': n <<= 30; break;
+	}
+	return n;
+}
+
+static void default_phase (synth_phase *p, int index) {
+	memset (p, 0, sizeof (*p));
+	p->base = (unsigned long long int) (index + 1) << 36;
+	p->nblocks = (16 << 20) / 64;
+	p->stride = 1;
+	p->weights[ACCESS_LOAD] = 70;
+	p->weights[ACCESS_STORE] = 30;
+	p->ipa = 10;
+	p->pcs = 64;
+}
+
+bool synth::parse (const char *spec) {
+	unsigned long long int seed = 1;
+	nphases = 1;
+	default_phase (&phases[0], 0);
+	// make every ';' a token of its own
+	char *copy = (char *) malloc (3 * strlen (spec) + 1), *save = NULL, *q = copy;
+	for (const char *c = spec; *c; c++) {
+		if (*c == ';') { *q++ = ' '; *q++ = ';'; *q++ = ' '; }
+		else *q++ = *c;
+	}
+	*q = 0;
+	bool ok = true;
+	for (char *tok = strtok_r (copy, ", \t\n", &save); tok; tok = strtok_r (NULL, ", \t\n", &save)) {
+		if (!strcmp (tok, ";")) {
+			if (nphases == SYNTH_MAX_PHASES) {
+				fprintf (stderr, "synth: too many phases\n");
+				ok = false;
+				break;
+			}
+			default_phase (&phases[nphases], nphases);
+			nphases++;
+			continue;
+		}
+		synth_phase *p = &phases[nphases-1];
+		char *eq = strchr (tok, '=');
+		if (!eq) {
+			fprintf (stderr, "synth: expected key=value, got \"%s\"\n", tok);
+			ok = false;
+			break;
+		}
+		*eq = 0;
+		const char *key = tok, *val = eq + 1;
+		if (!strcmp (key, "footprint")) p->nblocks = parse_size (val) / 64;
+		else if (!strcmp (key, "stride")) p->stride = parse_size (val) / 64;
+		else if (!strcmp (key, "zipf")) p->zipf = atof (val);
+		else if (!strcmp (key, "random")) p->random = atof (val);
+		else if (!strcmp (key, "chase")) p->chase = atof (val);
+		else if (!strcmp (key, "ifetch")) p->weights[ACCESS_IFETCH] = atof (val);
+		else if (!strcmp (key, "load")) p->weights[ACCESS_LOAD] = atof (val);
+		else if (!strcmp (key, "store")) p->weights[ACCESS_STORE] = atof (val);
+		else if (!strcmp (key, "prefetch")) p->weights[ACCESS_PREFETCH] = atof (val);
+		else if (!strcmp (key, "writeback")) p->weights[ACCESS_WRITEBACK] = atof (val);
+		else if (!strcmp (key, "ipa")) p->ipa = atoi (val);
+		else if (!strcmp (key, "pcs")) p->pcs = atoi (val);
+		else if (!strcmp (key, "seed")) seed = parse_size (val);
+		else if (!strcmp (key, "phase")) phase_length = parse_size (val);
+		else {
+			fprintf (stderr, "synth: unknown setting \"%s\"\n", key);
+			ok = false;
+			break;
+		}
+	}
+	free (copy);
+	for (int i=0; i<nphases && ok; i++) {
+		synth_phase *p = &phases[i];
+		double w = 0;
+		for (int j=0; j<ACCESS_MAX; j++) w += p->weights[j];
+		if (p->nblocks < 1) p->nblocks = 1;
+		if (p->stride < 1) p->stride = 1;
+		if (p->ipa < 1) p->ipa = 1;
+		if (p->pcs < 1) p->pcs = 1;
+		for (p->chase_mask = 1; p->chase_mask < p->nblocks; p->chase_mask <<= 1) ;
+		p->chase_mask--;
+		if (w <= 0) {
+			fprintf (stderr, "synth: phase %d has no accesses\n", i);
+			ok = false;
+		}
+	}
+	if (phase_length < 1) phase_length = 1;
+	state = seed * 0x9e3779b97f4a7c15ull + state;
+	if (!state) state = 1;
+	enter_phase (0);
+	return ok;
+}
+
+void synth::enter_phase (int i) {
+	current = i;
+	phase_start = instr;
+	stream_pos = 0;
+	chase_pos = 0;
+	synth_phase *p = &phases[i];
+	double w = 0, sum = 0;
+	for (int j=0; j<ACCESS_MAX; j++) w += p->weights[j];
+	for (int j=0; j<ACCESS_MAX; j++) {
+		sum += p->weights[j];
+		cdf[j] = w > 0 ? sum / w : 1;
+	}
+}
+
+// scatter block numbers so neighbours in rank aren't neighbours in the cache
+
+static inline unsigned long long int scramble (unsigned long long int x, unsigned long long int n) {
+	return (x * 0x9e3779b97f4a7c15ull >> 7) % n;
+}
+
+void synth::next (trace *t) {
+	if (instr - phase_start >= phase_length) enter_phase ((current + 1) % nphases);
+	synth_phase *p = &phases[current];
+
+	// how far apart accesses are: uniform on [1, 2*ipa-1], so the mean is ipa
+	instr += 1 + next_random () % (2 * p->ipa - 1);
+
+	double u = uniform ();
+	unsigned long long int block;
+	int pattern;
+	if (u < p->chase) {
+		// the next link depends only on the current one: a full-period
+		// LCG over the next power of two, skipping values off the end
+		do chase_pos = (chase_pos * 0x5851f42d4c957f2dull + 0x14057b7ef767814full) & p->chase_mask;
+		while (chase_pos >= p->nblocks);
+		block = chase_pos;
+		pattern = 0;
+	} else if (u < p->chase + p->random) {
+		block = next_random () % p->nblocks;
+		pattern = 1;
+	} else if (p->zipf > 0) {
+		// continuous approximation of the inverse Zipf CDF; rank 1 is the hottest
+		double n = (double) p->nblocks, v = uniform (), rank;
+		if (fabs (p->zipf - 1.0) < 1e-9) rank = pow (n, v);
+		else rank = pow ((pow (n, 1 - p->zipf) - 1) * v + 1, 1 / (1 - p->zipf));
+		unsigned long long int r = (unsigned long long int) rank;
+		if (r < 1) r = 1;
+		if (r > p->nblocks) r = p->nblocks;
+		block = scramble (r, p->nblocks);
+		pattern = 2;
+	} else {
+		block = stream_pos;
+		stream_pos = (stream_pos + p->stride) % p->nblocks;
+		pattern = 3;
+	}
+
+	double c = uniform ();
+	int cmd = ACCESS_LOAD;
+	for (int j=0; j<ACCESS_MAX; j++) if (c < cdf[j] && p->weights[j] > 0) { cmd = j; break; }
+
+	// PCs are tied to the pattern so a PC-indexed predictor has something to learn
+	int pcs = p->pcs;
+	int pcindex = (pattern * pcs / 4) + next_random () % (pcs < 4 ? 1 : pcs / 4);
+	t->cmd = cmd;
+	t->size = 8;
+	t->pc = 0x400000 + (unsigned long long int) current * 0x10000 + (pcindex % pcs) * 4;
+	t->address = p->base + block * 64 + (next_random () & 56);
+	t->instr = instr;
+	t->cycle = instr;
+}
@@ -0,0 +1,68 @@
+#ifndef __SYNTH_H
+#define __SYNTH_H
+
+// synthetic trace source. a tracereader whose file name starts with "gen:"
+// gets its records from one of these instead of a .gz file, e.g.
+//
+//	./exclusiu 'gen:footprint=64M,zipf=0.9,store=40;footprint=1M,stride=4096 phase=50000000'
+//
+// the spec is one or more phases separated by ';', each a comma- or
+// space-separated list of key=value settings:
+//
+//	footprint	bytes touched by the phase (K, M, G suffixes), default 16M
+//	stride		bytes between successive streaming accesses, default 64
+//	zipf		skew of the Zipf distribution over the footprint's blocks;
+//			0 (the default) streams with the stride instead
+//	random		fraction of accesses uniformly random over the footprint
+//	chase		fraction of accesses that follow a pointer chain, i.e.
+//			each address is a function of the previous one
+//	ifetch, load, store, prefetch, writeback
+//			relative weights of the access types, default load=70 store=30
+//	ipa		mean instructions per access, default 10
+//	pcs		number of distinct PCs, default 64
+//	seed		random seed, default 1. each generator adds its trace's
+//			index in the simulator, so cores running the same spec differ
+//	phase		instructions before moving to the next phase, default
+//			100M; the phases repeat in order
+//
+// every phase has its own base address so phases don't share blocks.
+
+#include "replacement_state.h"
+
+struct trace;
+
+#define SYNTH_MAX_PHASES	16
+
+struct synth_phase {
+	unsigned long long int base, nblocks, stride;
+	unsigned long long int chase_mask;	// next power of two above nblocks, minus one
+	double zipf, random, chase;
+	double weights[ACCESS_MAX];	// by CMP$im access type
+	int ipa, pcs;
+};
+
+class synth {
+	synth_phase phases[SYNTH_MAX_PHASES];
+	int nphases, current;
+	unsigned long long int phase_length, phase_start;
+	unsigned long long int state, instr;
+	unsigned long long int stream_pos, chase_pos;
+	double cdf[ACCESS_MAX];	// cumulative access type weights for the current phase
+
+	unsigned long long int next_random (void);
+	double uniform (void) { return (next_random () >> 11) * (1.0 / 9007199254740992.0); }
+	void enter_phase (int p);
+
+public:
+	// returns false and prints a message if the spec doesn't parse
+	bool parse (const char *spec);
+
+	// seed picks the random number stream
+	synth (unsigned long long int seed = 1);
+
+	// fill in the next record, with cmd as a CMP$im access type just like
+	// a record read from a trace file
+	void next (trace *t);
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef __TAGARRAY_H
+#define __TAGARRAY_H
+
+// the tags of a small fully-associative buffer (the victim and write
+// buffers): an array of block addresses, 0 in a free entry. lookups
+// compare the tags eight at a time without branching, which the compiler
+// turns into vector compares, so the array is padded to a multiple of
+// eight; the padding stays free and is never chosen. the buffers keep
+// whatever else they need per entry in arrays of slots alongside.
+
+#include <string.h>
+#include "arena.h"
+
+struct tag_array {
+	unsigned long long int *blocks;
+	int entries, slots;	// slots is entries rounded up to eight
+
+	void init (int n, arena *mem) {
+		entries = n;
+		slots = (n + 7) & ~7;
+		blocks = arena_new<unsigned long long int> (mem, slots);
+		memset (blocks, 0, slots * sizeof (*blocks));
+	}
+
+	// the entry holding block, or -1; find (0) is a free entry
+	int find (unsigned long long int block) const {
+		for (int i=0; i<slots; i+=8) {
+			unsigned int m = 0;
+			for (int j=0; j<8; j++) m |= (unsigned int) (blocks[i+j] == block) << j;
+			if (m) {
+				int k = i + __builtin_ctz (m);
+				return k < entries ? k : -1;
+			}
+		}
+		return -1;
+	}
+};
+
+#endif
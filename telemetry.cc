@@ -0,0 +1,95 @@
+// sampled per-set telemetry for the LLC; see telemetry.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "utils.h"
+#include "replacement_state.h"
+#include "stats.h"
+#include "cache.h"
+#include "telemetry.h"
+
+using namespace std;
+
+set_telemetry::set_telemetry (void) {
+	f = NULL;
+	set_mask = rate_mask = shift = 0;
+	events = 0;
+	nsets = 0;
+	interval = NULL;
+	total_misses = NULL;
+	last_core = NULL;
+	intervals = clean = dirty = distance = 0;
+	recording = false;
+}
+
+bool set_telemetry::open (const char *filename, cache *llc, int stride, int rate) {
+	if (stride < 1 || (stride & (stride - 1)) || stride > llc->nsets || rate < 1 || (rate & (rate - 1))) {
+		fprintf (stderr, "DAN_SET_TELEMETRY_STRIDE and DAN_SET_TELEMETRY_RATE must be powers of two, the stride at most %d\n", llc->nsets);
+		return false;
+	}
+	f = fopen (filename, "wb");
+	if (!f) {
+		perror (filename);
+		return false;
+	}
+	set_mask = stride - 1;
+	rate_mask = rate - 1;
+	shift = __builtin_ctz (stride);
+	nsets = llc->nsets / stride;
+	interval = (set_sample *) calloc (nsets, sizeof (set_sample));
+	total_misses = (unsigned long long int *) calloc (nsets, sizeof (unsigned long long int));
+	last_core = (unsigned char *) calloc (nsets, 1);
+	unsigned int header[5] = { (unsigned int) nsets, (unsigned int) stride, (unsigned int) rate, (unsigned int) llc->assoc, sizeof (set_sample) };
+	fwrite ("SETTELE1", 8, 1, f);
+	fwrite (header, sizeof (header), 1, f);
+	return true;
+}
+
+void set_telemetry::end_interval (cache *llc, unsigned long long int records) {
+	if (!f || !recording) return;
+	bool rwp = llc->replacement_policy >= REPLACEMENT_POLICY_CRC;
+	for (int i=0; i<nsets; i++) {
+		unsigned int set = i << shift;
+		set_sample *s = &interval[i];
+		s->dirty_lines = __builtin_popcountll (llc->sets[set].dirty_mask);
+		s->rwp_distance = rwp ? (int) llc->repl->GetNumDirtyLines (set, last_core[i]) - (int) llc->repl->GetPredNumDirtyLines (last_core[i]) : 0;
+		total_misses[i] += s->misses;
+		clean += s->clean_evictions;
+		dirty += s->dirty_evictions;
+		distance += abs (s->rwp_distance);
+	}
+	fwrite (&records, sizeof (records), 1, f);
+	fwrite (interval, sizeof (set_sample), nsets, f);
+	memset (interval, 0, nsets * sizeof (set_sample));
+	intervals++;
+}
+
+set_telemetry::~set_telemetry (void) {
+	close ();
+	free (interval);
+	free (total_misses);
+	free (last_core);
+}
+
+void set_telemetry::report (FILE *out) {
+	if (!interval) return;
+	fprintf (out, "set telemetry: %lld intervals of %d sets (every %d%s), victims from the dirty partition %0.4f, mean |RWP dirty lines - prediction| %0.2f\n",
+		intervals, nsets, set_mask + 1, rate_mask ? ", sampled" : "",
+		clean + dirty ? (double) dirty / (clean + dirty) : 0.0,
+		intervals ? (double) distance / (intervals * nsets) : 0.0);
+	vector<int> v;
+	for (int i=0; i<nsets; i++) v.push_back (i);
+	int n = min (nsets, 8);
+	partial_sort (v.begin (), v.begin () + n, v.end (), [this] (int a, int b) { return total_misses[a] > total_misses[b]; });
+	fprintf (out, "set telemetry: most missed sets:");
+	for (int k=0; k<n; k++) fprintf (out, " %d (%lld)", v[k] << shift, total_misses[v[k]]);
+	fprintf (out, "\n");
+}
+
+void set_telemetry::close (void) {
+	if (f) fclose (f);
+	f = NULL;
+}
@@ -0,0 +1,79 @@
+#ifndef __TELEMETRY_H
+#define __TELEMETRY_H
+
+// per-set telemetry for the LLC: which sets thrash, which partition the
+// victims come from, and how far RWP's dirty line count in each set is
+// from its prediction. with DAN_SET_TELEMETRY=file it watches every
+// DAN_SET_TELEMETRY_STRIDE'th set (64 by default; 1 for all of them) and
+// counts one in DAN_SET_TELEMETRY_RATE (1) of their misses and evictions,
+// both powers of two, so it costs a mask test on the miss path. after
+// warming, every DAN_SET_TELEMETRY_INTERVAL trace records (1000000) it
+// appends one row of the heatmap to the file:
+//
+//	header:	char magic[8] "SETTELE1"
+//		unsigned int sets, stride, rate, assoc, record_bytes
+//	a row:	unsigned long long int records	trace records so far
+//		sets of set_sample, the watched sets in order
+//
+// and the run ends with a summary. counts are as sampled, not scaled up.
+// with a prediction per core (DAN_RWP_PER_CORE=1) a set's distance is
+// that of the core that last evicted from it: the dirty lines that core
+// filled there, less its prediction. uses cache.h.
+
+#include <stdio.h>
+
+struct set_sample {
+	unsigned int misses;
+	unsigned int clean_evictions;	// victims from the clean partition; for
+	unsigned int dirty_evictions;	// RWP by its dirty bit, else the block's
+	unsigned int victim_position_sum;	// victims' stack positions, added up
+	unsigned short dirty_lines;	// at the end of the interval
+	short rwp_distance;		// RWP's dirty lines less its prediction, at the end
+};
+
+class set_telemetry {
+	FILE *f;
+	unsigned int set_mask, rate_mask, shift;
+	unsigned int events;
+	int nsets;
+	set_sample *interval;		// this interval's counts
+	unsigned long long int *total_misses;	// per watched set, for the summary
+	unsigned char *last_core;	// per watched set, whose access last evicted from it
+	unsigned long long int intervals, clean, dirty, distance;
+
+public:
+	bool recording;		// false while warming
+
+	set_telemetry (void);
+	~set_telemetry (void);
+
+	// false if the file can't be written or stride and rate aren't powers of two
+	bool open (const char *filename, cache *llc, int stride, int rate);
+
+	// the slot set is counted in for this event, or -1
+	int sample (unsigned int set) {
+		if (!recording || (set & set_mask)) return -1;
+		if (++events & rate_mask) return -1;
+		return set >> shift;
+	}
+	void miss (unsigned int set) {
+		int i = sample (set);
+		if (i >= 0) interval[i].misses++;
+	}
+	void evicted (unsigned int set, unsigned int core, bool dirty_partition, unsigned int position) {
+		if (!(set & set_mask)) last_core[set >> shift] = core;
+		int i = sample (set);
+		if (i < 0) return;
+		if (dirty_partition) interval[i].dirty_evictions++;
+		else interval[i].clean_evictions++;
+		interval[i].victim_position_sum += position;
+	}
+
+	// write a row for the interval ending now
+	void end_interval (cache *llc, unsigned long long int records);
+
+	void report (FILE *out);
+	void close (void);
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef __TIMING_H
+#define __TIMING_H
+
+// interval timing model with memory-level parallelism. the linear models
+// in model.h charge every LLC miss the same number of cycles, so a miss
+// that overlaps with others costs as much as an isolated one. here, a
+// demand miss opens an interval that lasts as long as it takes to fill a
+// reorder buffer of DAN_ROB instructions (192 by default) behind it; any
+// miss issued by an instruction inside that window overlaps with the first
+// and the whole interval stalls only for the longest latency among them.
+// at most DAN_MSHRS misses (16 by default) can be outstanding at once; the
+// next one has to wait, so it starts a new interval.
+//
+//	cycles = instructions * base CPI + sum over intervals of the stall
+//
+// the base CPI is the intercept of the benchmark's linear model, i.e. its
+// CPI with no LLC misses (0.33333 for benchmarks without a model). the
+// misses are demand accesses that had to read memory; each takes
+// DAN_MEM_LATENCY cycles (270 by default, like the fallback model), or
+// whatever the DRAM model says if DAN_DRAM=1. enable with DAN_TIMING=1.
+
+struct interval_model {
+	unsigned long long int rob;		// window size in instructions
+	unsigned long long int mshrs;		// most misses that can overlap
+	unsigned long long int window_misses;	// misses overlapping in the open window, at most mshrs
+	unsigned long long int window_end;	// first instruction past the open window
+	unsigned long long int window_stall;	// longest latency in the open window
+	bool open;
+
+	// totals over closed intervals
+	unsigned long long int misses, intervals, stall_cycles;
+
+	interval_model (void) {
+		rob = 192;
+		mshrs = 16;
+		window_misses = 0;
+		window_end = 0;
+		window_stall = 0;
+		open = false;
+		misses = 0;
+		intervals = 0;
+		stall_cycles = 0;
+	}
+
+	// a demand miss by the instruction numbered instr that takes latency cycles
+
+	void miss (unsigned long long int instr, unsigned long long int latency) {
+		if (!open || instr >= window_end || window_misses >= mshrs) {
+			close ();
+			open = true;
+			window_end = instr + rob;
+			window_stall = 0;
+			window_misses = 0;
+			intervals++;
+		}
+		window_misses++;
+		if (latency > window_stall) window_stall = latency;
+		misses++;
+	}
+
+	void close (void) {
+		if (open) stall_cycles += window_stall;
+		open = false;
+	}
+
+	// stall so far, counting the open interval
+	unsigned long long int stall (void) { return stall_cycles + (open ? window_stall : 0); }
+
+	// average number of misses overlapped per interval
+	double mlp (void) { return intervals ? (double) misses / intervals : 0.0; }
+};
+
+#endif
@@ -2,6 +2,8 @@
 #include <unistd.h>
 #include <zlib.h>
 #include <map>
+#include "profile.h"
+#include "synth.h"
 
 using namespace std;
 
@@ -14,9 +16,19 @@ struct trace {
         unsigned long long int cycle;
 };
 
+// reads a gzipped trace file, or generates records if the name starts
+// with "gen:" (see synth.h). records are decoded up to TRACE_WINDOW ahead
+// of the one read() hands out, so peek() can show what is coming; the
+// counts and the heartbeat only move when read() consumes a record.
+
+#define TRACE_WINDOW	16
+
 class tracereader {
 	gzFile tracefp;
+	synth *gen;
 	trace t;
+	trace window[TRACE_WINDOW];
+	int window_head, window_count;
 	unsigned long long int icount, current_cycle, current_instr, cyclecount;
 	unsigned long long int insts_upto_restart, cycles_upto_restart;
 	char filename[1000];
@@ -24,6 +36,10 @@ class tracereader {
 
 public:
 
+	// print a line every 100M instructions; off when the statistics go
+	// to a file, so the simulation thread does no stdio of its own
+	bool heartbeat;
+
 	unsigned long long int get_icount (void) { return icount; }
 	unsigned long long int get_cycles (void) { return cyclecount; }
 
@@ -58,9 +74,17 @@ public:
 		open (filename);
 	}
 
-	trace *read (void) {
+	// decode the next record from the file into t
+
+	void fetch (trace &t) {
 	startover:
-		unsigned int a = gzfread (&t, sizeof (t), 1, tracefp);
+		PROF_BEGIN (PROF_TRACE_READ, prof_read);
+		unsigned int a;
+		if (gen) {
+			gen->next (&t);
+			a = 1;
+		} else a = gzfread (&t, sizeof (t), 1, tracefp);
+		PROF_END (PROF_TRACE_READ, prof_read);
 		if (a == 0) {
 			// printf ("restarting before %lld cycles!\n", restart_cycles);
 			restart_cycles = current_cycle;
@@ -85,11 +109,12 @@ public:
 
 		// heartbeat
 
-		if (t.cycle >= (unsigned long long int) restart_cycles) {
+		if (!gen && t.cycle >= (unsigned long long int) restart_cycles) {
 			restart ();
 			goto startover;
 		}
 		// this is stupid but we have to translate from CMP$im to DAN_* and back
+		PROF_BEGIN (PROF_TRANSLATE, prof_translate);
 		int cmd = t.cmd;
 		switch (cmd) {
 			case ACCESS_IFETCH: t.cmd = DAN_IREAD; break;
@@ -99,6 +124,7 @@ public:
 			case ACCESS_WRITEBACK: t.cmd = DAN_WRITEBACK; break;
 			default: assert (0);
 		}
+		PROF_END (PROF_TRANSLATE, prof_translate);
 #if 0
 		printf ("cmd=%d; pc=%llx; address=%llx; instr=%llx; cycle=%llx\n",
 			t.cmd, t.pc, t.address, t.instr, t.cycle);
@@ -107,18 +133,44 @@ public:
 		current_instr = t.instr;
 		t.cycle += cycles_upto_restart;
 		t.instr += insts_upto_restart;
+	}
+
+	void fill (void) {
+		while (window_count < TRACE_WINDOW) {
+			fetch (window[(window_head + window_count) % TRACE_WINDOW]);
+			window_count++;
+		}
+	}
+
+	// the record k after the one the last read() returned, 0 < k <= TRACE_WINDOW
+
+	const trace *peek (int k) {
+		fill ();
+		return &window[(window_head + k - 1) % TRACE_WINDOW];
+	}
+
+	trace *read (void) {
+		fill ();
+		t = window[window_head];
+		window_head = (window_head + 1) % TRACE_WINDOW;
+		window_count--;
 		cyclecount = t.cycle;
 		if (t.instr - icount >= 100000000) {
 			icount = t.instr;
-			printf ("icount = %lld, cycles = %lld\n", icount, cyclecount);
-			fflush (stdout);
+			if (heartbeat) {
+				printf ("icount = %lld, cycles = %lld\n", icount, cyclecount);
+				fflush (stdout);
+			}
 		}
 		return & t;
 	}
 
 	// constructor
 
-	tracereader (const char *name, long long int _restart_cycles = 1000000000) {
+	// index is which of the simulator's traces this is; generated
+	// traces are seeded by it
+
+	tracereader (const char *name, int index = 0, long long int _restart_cycles = 1000000000) {
 		restart_cycles = _restart_cycles;
 		current_cycle = 0;
 		current_instr = 0;
@@ -126,15 +178,28 @@ public:
 		insts_upto_restart = 0;
 		icount = 0;
 		cyclecount = 0;
+		heartbeat = true;
+		window_head = 0;
+		window_count = 0;
 		strcpy (filename, name);
-		open (filename);
+		gen = NULL;
+		tracefp = NULL;
+		if (strncmp (name, "gen:", 4) == 0) {
+			gen = new synth (1 + index);
+			if (!gen->parse (name + 4)) {
+				fprintf (stderr, "bad generator spec \"%s\"\n", name + 4);
+				exit (1);
+			}
+		} else open (filename);
 		printf ("opened \"%s\"\n", filename);
 		fflush (stdout);
 	}
 
 	void close (void) {
-		gzclose (tracefp);
+		if (tracefp) gzclose (tracefp);
 		tracefp = NULL;
+		delete gen;
+		gen = NULL;
 	}
 
 	// destructor
@@ -0,0 +1,69 @@
+// tracegen: write a synthetic trace (see synth.h) to a gzipped trace file
+// in the same format as the SPEC traces, so it can be shipped around or
+// read back with exclusiu like any other trace.
+//
+// usage: tracegen [-n records] spec output.gz
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "replacement_state.h"
+#include "stats.h"
+#include "cache.h"
+#include "trace.h"
+#include "synth.h"
+
+using namespace std;
+
+int main (int argc, char *argv[]) {
+	long long int n = 10000000;
+	int c;
+	while ((c = getopt (argc, argv, "n:")) != -1) {
+		switch (c) {
+		case 'n': n = atoll (optarg); break;
+		default:
+			fprintf (stderr, "usage: %s [-n records] spec output.gz\n", argv[0]);
+			return 1;
+		}
+	}
+	if (argc - optind != 2) {
+		fprintf (stderr, "usage: %s [-n records] spec output.gz\n", argv[0]);
+		return 1;
+	}
+	const char *spec = argv[optind];
+	if (strncmp (spec, "gen:", 4) == 0) spec += 4;
+	synth gen;
+	if (!gen.parse (spec)) return 1;
+	gzFile f = gzopen (argv[optind+1], "wb1");
+	if (!f) {
+		perror (argv[optind+1]);
+		return 1;
+	}
+
+	// generate in batches so gzwrite sees big buffers
+
+	const int batch = 4096;
+	trace *buf = new trace[batch];
+	struct timespec start, end;
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	for (long long int done = 0; done < n; ) {
+		int k = n - done < batch ? (int) (n - done) : batch;
+		for (int i=0; i<k; i++) gen.next (&buf[i]);
+		if (gzwrite (f, buf, k * sizeof (trace)) != (int) (k * sizeof (trace))) {
+			fprintf (stderr, "%s: write failed\n", argv[optind+1]);
+			return 1;
+		}
+		done += k;
+	}
+	gzclose (f);
+	clock_gettime (CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	fprintf (stderr, "wrote %lld records to %s in %0.2f seconds\n", n, argv[optind+1], seconds);
+	delete[] buf;
+	return 0;
+}
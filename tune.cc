@@ -0,0 +1,229 @@
+// tune: search the replacement policies' parameters (exclusiu -params
+// lists them) for the settings with the best geometric mean speedup over
+// LRU, by successive halving.
+//
+// usage: tune [-l benchmark-list] [-p policy] [-n candidates] [-i insts] [-e eta] [-s seed] NAME=values ...
+//
+// each NAME=values gives the values one parameter may take, either as a
+// list (DAN_RWP_UPDATE_INTERVAL=1,16,256) or as an integer range lo:hi
+// (DAN_RWP_COUNTER_BITS=4:16). -n points of that space (16 by default)
+// are drawn at random without repeats, or all of them if there are no
+// more than that, and the policy's defaults are always a candidate too.
+//
+// every NAME must be a registered parameter and every value in its range;
+// the search doesn't start otherwise.
+//
+// the first round runs every candidate under -p (2 by default) on every
+// benchmark in the list (benchmarks.txt) for only -i instructions (10M)
+// after warming for a quarter as many. this is a search over trace
+// prefixes, not sampled intervals: every round simulates each trace from
+// its start, so a candidate is judged on its benchmarks' opening phases
+// until the rounds get long. each round keeps the best 1/eta of
+// the candidates (-e, 2) and runs them again with eta times as many
+// instructions, until one is left. a round's simulations, LRU at that
+// length included, all go to the work-stealing pool with DAN_JOBS
+// workers, and results are kept in the results cache like suite's, so an
+// interrupted search picks up where it stopped.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+#include "runner.h"
+#include "replacement_state.h"
+
+using namespace std;
+
+// one parameter's values: a list, or the integers lo to hi
+
+struct dimension {
+	string name;
+	vector<string> values;
+	long long int lo, hi;
+
+	long long int size (void) const { return values.empty () ? hi - lo + 1 : (long long int) values.size (); }
+	string value (long long int i) const { return values.empty () ? to_string (lo + i) : values[i]; }
+};
+
+struct candidate {
+	vector<string> env;	// NAME=value for each dimension; empty for the defaults
+	double score;		// geomean speedup over LRU in the last round it ran, 0 if a run failed
+};
+
+static bool parse_dimension (const char *spec, dimension *d) {
+	const char *eq = strchr (spec, '=');
+	if (!eq || eq == spec || !eq[1]) return false;
+	d->name = string (spec, eq - spec);
+	const char *v = eq + 1;
+	char *end;
+	d->lo = strtoll (v, &end, 0);
+	if (end != v && *end == ':') {
+		const char *h = end + 1;
+		d->hi = strtoll (h, &end, 0);
+		return end != h && !*end && d->hi >= d->lo;
+	}
+	string cur;
+	for (; *v; v++) {
+		if (*v == ',') {
+			if (cur.size ()) d->values.push_back (cur);
+			cur.clear ();
+		} else cur += *v;
+	}
+	if (cur.size ()) d->values.push_back (cur);
+	return !d->values.empty ();
+}
+
+// the dimension's name is a registered parameter and all its values are
+// in range; says why not on stderr
+
+static bool check_dimension (const dimension &d) {
+	const param *p = params_find (policy_param_table, policy_param_count, d.name.c_str ());
+	if (!p) {
+		fprintf (stderr, "no parameter %s; exclusiu -params lists them\n", d.name.c_str ());
+		return false;
+	}
+	double x;
+	if (d.values.empty ()) return params_parse (p, to_string (d.lo).c_str (), &x) && params_parse (p, to_string (d.hi).c_str (), &x);
+	for (size_t i=0; i<d.values.size(); i++) if (!params_parse (p, d.values[i].c_str (), &x)) return false;
+	return true;
+}
+
+static string describe (const candidate &c) {
+	if (c.env.empty ()) return "(defaults)";
+	string s;
+	for (size_t i=0; i<c.env.size(); i++) s += (i ? " " : "") + c.env[i];
+	return s;
+}
+
+// the candidates: every point of the space if it has no more than n,
+// otherwise n distinct random ones
+
+static vector<candidate> draw_candidates (const vector<dimension> &dims, int n) {
+	vector<candidate> v;
+	candidate c;
+	c.score = 0;
+	v.push_back (c);
+	double space = 1;
+	for (size_t d=0; d<dims.size(); d++) space *= dims[d].size ();
+	set<vector<string> > seen;
+	for (long long int k=0; (int) seen.size () < n && (space <= n ? k < (long long int) space : k < 100LL * n); k++) {
+		c.env.clear ();
+		long long int rest = k;
+		for (size_t d=0; d<dims.size(); d++) {
+			long long int i;
+			if (space <= n) {
+				i = rest % dims[d].size ();
+				rest /= dims[d].size ();
+			} else i = ((long long int) rand () * RAND_MAX + rand ()) % dims[d].size ();
+			c.env.push_back (dims[d].name + "=" + dims[d].value (i));
+		}
+		if (seen.insert (c.env).second) v.push_back (c);
+	}
+	return v;
+}
+
+static int usage (const char *name) {
+	fprintf (stderr, "usage: %s [-l benchmark-list] [-p policy] [-n candidates] [-i insts] [-e eta] [-s seed] NAME=values ...\n", name);
+	return 1;
+}
+
+int main (int argc, char *argv[]) {
+	const char *listname = "benchmarks.txt";
+	string policy = "2";
+	int ncandidates = 16, eta = 2, seed = 1;
+	long long int insts = 10000000;
+	int c;
+	while ((c = getopt (argc, argv, "l:p:n:i:e:s:")) != -1) {
+		switch (c) {
+		case 'l': listname = optarg; break;
+		case 'p': policy = optarg; break;
+		case 'n': ncandidates = atoi (optarg); break;
+		case 'i': insts = atoll (optarg); break;
+		case 'e': eta = atoi (optarg); break;
+		case 's': seed = atoi (optarg); break;
+		default: return usage (argv[0]);
+		}
+	}
+	if (ncandidates < 1 || eta < 2 || insts < 1) return usage (argv[0]);
+	vector<dimension> dims;
+	for (int i=optind; i<argc; i++) {
+		dimension d;
+		if (!parse_dimension (argv[i], &d)) {
+			fprintf (stderr, "bad parameter values \"%s\"; use NAME=a,b,c or NAME=lo:hi\n", argv[i]);
+			return 1;
+		}
+		if (!check_dimension (d)) return 1;
+		dims.push_back (d);
+	}
+	if (dims.empty ()) return usage (argv[0]);
+	vector<string> bench = read_benchmark_list (listname);
+	if (bench.empty ()) {
+		fprintf (stderr, "no benchmarks in %s\n", listname);
+		return 1;
+	}
+	srand (seed);
+	vector<candidate> alive = draw_candidates (dims, ncandidates);
+	results_cache cache;
+	int nb = (int) bench.size ();
+
+	for (int round=0; ; round++) {
+		string length = "DAN_MAX_INST=" + to_string (insts);
+		string warm = "DAN_WARM_INST=" + to_string (insts / 4);
+
+		// jobs[k * nb + b] is benchmark b under candidate k, with
+		// k == alive.size () for LRU
+
+		int nc = (int) alive.size ();
+		vector<run_job> jobs ((nc + 1) * nb);
+		for (int k=0; k<=nc; k++) {
+			for (int b=0; b<nb; b++) {
+				run_job &j = jobs[k * nb + b];
+				j.traces.push_back (bench[b]);
+				j.env.push_back (length);
+				j.env.push_back (warm);
+				if (k == nc) j.env.push_back ("DAN_POLICY=0");
+				else {
+					j.env.push_back ("DAN_POLICY=" + policy);
+					j.env.insert (j.env.end (), alive[k].env.begin (), alive[k].env.end ());
+				}
+			}
+		}
+		run_all (jobs, runner_jobs (), &cache);
+
+		for (int k=0; k<nc; k++) {
+			double logsum = 0;
+			bool ok = true;
+			for (int b=0; b<nb && ok; b++) {
+				run_job &j = jobs[k * nb + b], &base = jobs[nc * nb + b];
+				ok = j.ok && base.ok && base.result.ipc[0] > 0 && j.result.ipc[0] > 0;
+				if (ok) logsum += log (j.result.ipc[0] / base.result.ipc[0]);
+			}
+			alive[k].score = ok ? exp (logsum / nb) : 0;
+		}
+		stable_sort (alive.begin (), alive.end (), [] (const candidate &a, const candidate &b) { return a.score > b.score; });
+
+		printf ("round %d: %d candidates, %lld instructions, %d benchmarks\n", round, nc, insts, nb);
+		printf ("  %10s  %s\n", "geomean", "settings");
+		for (int k=0; k<nc; k++) {
+			if (alive[k].score > 0) printf ("  %10.4f", alive[k].score);
+			else printf ("  %10s", "-");
+			printf ("  %s\n", describe (alive[k]).c_str ());
+		}
+		fflush (stdout);
+
+		if (nc == 1) break;
+		alive.resize ((nc + eta - 1) / eta);
+		insts *= eta;
+	}
+	if (alive[0].score <= 0) {
+		fprintf (stderr, "every candidate had a failed simulation\n");
+		return 1;
+	}
+	printf ("best: %s, geomean speedup %0.4f over LRU at %lld instructions\n", describe (alive[0]).c_str (), alive[0].score, insts);
+	return 0;
+}
@@ -15,4 +15,17 @@ struct LINE_STATE {
 	Addr_t tag;
 };
 
+// xorshift64*, for anything that needs cheap random numbers of its own
+
+struct xorshift {
+	unsigned long long int s;
+	xorshift (unsigned long long int seed = 1) { s = seed ? seed : 1; }
+	unsigned long long int next (void) {
+		s ^= s >> 12;
+		s ^= s << 25;
+		s ^= s >> 27;
+		return s * 0x2545f4914f6cdd1dull;
+	}
+};
+
 #endif
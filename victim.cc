@@ -0,0 +1,98 @@
+// victim buffer between the LLC and memory; see victim.h
+
+#include <stdio.h>
+#include <string.h>
+#include "utils.h"
+#include "replacement_state.h"
+#include "victim.h"
+#include "arena.h"
+
+using namespace std;
+
+victim_buffer::victim_buffer (int n, int pol, unsigned long long int seed, arena *m) {
+	owns_mem = !m;
+	mem = m ? m : new arena;
+	if (n < 1) n = 1;
+	if (n > VICTIM_MAX_ENTRIES) n = VICTIM_MAX_ENTRIES;
+	policy = pol;
+	clock = 0;
+	random = xorshift (seed);
+	tags.init (n, mem);
+	stamps = arena_new<unsigned long long int> (mem, tags.slots);
+	dirty = arena_new<unsigned char> (mem, tags.slots);
+	memset (stamps, 0, tags.slots * sizeof (*stamps));
+	memset (dirty, 0, tags.slots);
+	rescued.init (tags.entries, mem);
+	rescued_dirty = arena_new<unsigned char> (mem, rescued.slots);
+	memset (rescued_dirty, 0, rescued.slots);
+	next_rescued = 0;
+	memset (&stats, 0, sizeof (stats));
+}
+
+victim_buffer::~victim_buffer (void) {
+	if (owns_mem) delete mem;
+}
+
+bool victim_buffer::extract (unsigned long long int block, int at) {
+	stats.lookups++;
+	int i = tags.find (block);
+	if (i < 0) return false;
+	stats.hits++;
+	stats.hits_by_type[at]++;
+	tags.blocks[i] = 0;
+
+	// remember it until it comes back down, in a free entry or else in
+	// the next one in turn
+
+	int k = rescued.find (0);
+	if (k < 0) {
+		k = next_rescued;
+		next_rescued = (next_rescued + 1) % rescued.entries;
+	}
+	rescued.blocks[k] = block;
+	rescued_dirty[k] = dirty[i];
+	return true;
+}
+
+bool victim_buffer::returned (unsigned long long int block, bool *was_dirty) {
+	int i = rescued.find (block);
+	if (i < 0) return false;
+	stats.returned++;
+	rescued.blocks[i] = 0;
+	*was_dirty = rescued_dirty[i];
+	return true;
+}
+
+unsigned long long int victim_buffer::insert (unsigned long long int block, bool is_dirty) {
+	unsigned long long int out = 0;
+	stats.inserts++;
+	int i = tags.find (0);
+	if (i < 0) {
+		if (policy == VICTIM_RANDOM) i = random.next () % tags.entries;
+		else {
+			i = 0;
+			for (int k=1; k<tags.entries; k++) if (stamps[k] < stamps[i]) i = k;
+		}
+		stats.evictions++;
+		if (dirty[i]) {
+			stats.dirty_evictions++;
+			out = tags.blocks[i];
+		}
+	}
+	tags.blocks[i] = block;
+	dirty[i] = is_dirty;
+	stamps[i] = ++clock;
+	return out;
+}
+
+void victim_buffer::report (FILE *f, const victim_stats *since) {
+	unsigned long long int lookups = stats.lookups - since->lookups, hits = stats.hits - since->hits;
+	fprintf (f, "victim buffer %d entries, %s: %lld hits in %lld lookups (%0.4f); hits by type: ifetch %lld load %lld store %lld prefetch %lld; %lld came back to the LLC; %lld inserts, %lld evictions (%lld dirty)\n",
+		tags.entries, policy == VICTIM_RANDOM ? "random" : "fifo", hits, lookups, lookups ? (double) hits / lookups : 0.0,
+		stats.hits_by_type[ACCESS_IFETCH] - since->hits_by_type[ACCESS_IFETCH],
+		stats.hits_by_type[ACCESS_LOAD] - since->hits_by_type[ACCESS_LOAD],
+		stats.hits_by_type[ACCESS_STORE] - since->hits_by_type[ACCESS_STORE],
+		stats.hits_by_type[ACCESS_PREFETCH] - since->hits_by_type[ACCESS_PREFETCH],
+		stats.returned - since->returned,
+		stats.inserts - since->inserts, stats.evictions - since->evictions, stats.dirty_evictions - since->dirty_evictions);
+}
@@ -0,0 +1,77 @@
+#ifndef __VICTIM_H
+#define __VICTIM_H
+
+// a victim buffer: a small fully-associative store between the LLC and
+// memory that catches the blocks the LLC evicts. a demand access that
+// misses in the LLC looks there next, and if its block was evicted
+// recently it moves up to the core as it would from the LLC instead of
+// being read from memory, so it counts as an LLC hit. a dirty block the
+// buffer pushes out goes to memory.
+//
+// it sits under the exclusive hierarchy, where a block is in one place at
+// a time: a hit takes the block out, and an entry is never touched between
+// going in and coming out, so LRU replacement would be the same as FIFO.
+// DAN_VICTIM_ENTRIES sets its size (0, no buffer, by default) and
+// DAN_VICTIM_POLICY is fifo (the default) or random.
+//
+// the tags are a tag_array (tagarray.h). uses utils.h and
+// replacement_state.h.
+//
+// hits are counted by access type, and they feed the LLC's replacement
+// policy an early-reuse signal: the buffer remembers the blocks it sent
+// up (as many as it has entries), and when one comes back down to the
+// LLC as an L2 victim the policy is told it was reused after the LLC had
+// let it go (CACHE_REPLACEMENT_STATE::EarlyReuse).
+
+#include <stdio.h>
+#include "tagarray.h"
+
+#define VICTIM_MAX_ENTRIES	256
+
+#define VICTIM_FIFO	0
+#define VICTIM_RANDOM	1
+
+struct victim_stats {
+	unsigned long long int lookups, hits;
+	unsigned long long int hits_by_type[ACCESS_MAX];	// by CRC access type
+	unsigned long long int inserts, evictions, dirty_evictions;
+	unsigned long long int returned;	// hits that came back to the LLC
+};
+
+class victim_buffer {
+	tag_array tags;
+	unsigned long long int *stamps;	// when each went in, for FIFO
+	unsigned char *dirty;
+	int policy;
+	tag_array rescued;		// the blocks hits sent up, until they come back
+	unsigned char *rescued_dirty;	// whether each was dirty in the buffer
+	int next_rescued;		// replaced in turn
+	unsigned long long int clock;
+	xorshift random;
+	arena *mem;		// where the entries live
+	bool owns_mem;		// mem is the buffer's own, deleted with it
+
+public:
+	victim_stats stats;
+
+	// the entries come from mem, or with none from an arena of its own
+	victim_buffer (int entries, int policy, unsigned long long int seed, arena *mem = NULL);
+	~victim_buffer (void);
+
+	// take the block out if it is here; returns true if it was. at is the
+	// CRC access type of the access looking for it
+	bool extract (unsigned long long int block, int at);
+
+	// put an LLC victim in; returns the address of a dirty block this
+	// pushes out to memory, or 0
+	unsigned long long int insert (unsigned long long int block, bool is_dirty);
+
+	// an L2 victim going into the LLC: true if a hit here sent it up and
+	// it hasn't come back since, with *was_dirty as it was in the buffer.
+	// it is forgotten either way
+	bool returned (unsigned long long int block, bool *was_dirty);
+
+	void report (FILE *f, const victim_stats *since);
+};
+
+#endif
@@ -0,0 +1,83 @@
+// write-combining buffer between the L2s and the LLC; see writebuf.h
+
+#include <stdio.h>
+#include <string.h>
+#include "writebuf.h"
+#include "arena.h"
+
+write_buffer::write_buffer (int n, int pol, arena *m) {
+	owns_mem = !m;
+	mem = m ? m : new arena;
+	if (n < 1) n = 1;
+	if (n > WRITEBUF_MAX_ENTRIES) n = WRITEBUF_MAX_ENTRIES;
+	policy = pol;
+	clock = 0;
+	tags.init (n, mem);
+	stamps = arena_new<unsigned long long int> (mem, tags.slots);
+	pcs = arena_new<unsigned long long int> (mem, tags.slots);
+	cores = arena_new<unsigned int> (mem, tags.slots);
+	forwarded = arena_new<unsigned char> (mem, tags.slots);
+	memset (stamps, 0, tags.slots * sizeof (*stamps));
+	memset (pcs, 0, tags.slots * sizeof (*pcs));
+	memset (cores, 0, tags.slots * sizeof (*cores));
+	memset (forwarded, 0, tags.slots);
+	memset (&stats, 0, sizeof (stats));
+}
+
+write_buffer::~write_buffer (void) {
+	if (owns_mem) delete mem;
+}
+
+bool write_buffer::forward (unsigned long long int block) {
+	stats.lookups++;
+	int i = tags.find (block);
+	// a forwarded block's only copy is up in a core, so it isn't here to
+	// serve; the access goes on to memory like any other miss
+	if (i < 0 || forwarded[i]) return false;
+	stats.hits++;
+	forwarded[i] = 1;
+	return true;
+}
+
+bool write_buffer::write (unsigned long long int block, unsigned long long int pc, unsigned int core, writebuf_entry *out) {
+	stats.writes++;
+	int i = tags.find (block);
+	if (i >= 0) {
+		// the block came back down from the core it was forwarded to
+		stats.coalesced++;
+		forwarded[i] = 0;
+		pcs[i] = pc;
+		cores[i] = core;
+		if (policy == WRITEBUF_LRU) stamps[i] = ++clock;
+		return false;
+	}
+	bool drained = false;
+	i = tags.find (0);
+	if (i < 0) {
+		i = 0;
+		for (int k=1; k<tags.entries; k++) if (stamps[k] < stamps[i]) i = k;
+		if (forwarded[i]) stats.dropped++;
+		else {
+			out->block = tags.blocks[i];
+			out->pc = pcs[i];
+			out->core = cores[i];
+			stats.drains++;
+			drained = true;
+		}
+	}
+	tags.blocks[i] = block;
+	pcs[i] = pc;
+	cores[i] = core;
+	forwarded[i] = 0;
+	stamps[i] = ++clock;
+	return drained;
+}
+
+void write_buffer::report (FILE *f, const writebuf_stats *since) {
+	unsigned long long int writes = stats.writes - since->writes, coalesced = stats.coalesced - since->coalesced;
+	unsigned long long int lookups = stats.lookups - since->lookups, hits = stats.hits - since->hits;
+	fprintf (f, "write buffer %d entries, %s drain: %lld writebacks, %lld coalesced (%0.4f); %lld hits in %lld lookups (%0.4f); %lld drained into the LLC, %lld dropped\n",
+		tags.entries, policy == WRITEBUF_LRU ? "lru" : "fifo", writes, coalesced, writes ? (double) coalesced / writes : 0.0,
+		hits, lookups, lookups ? (double) hits / lookups : 0.0,
+		stats.drains - since->drains, stats.dropped - since->dropped);
+}
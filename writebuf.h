@@ -0,0 +1,77 @@
+#ifndef __WRITEBUF_H
+#define __WRITEBUF_H
+
+// a write-combining buffer between the L2s and the exclusive LLC. the
+// blocks the L2s evict wait here on their way into the LLC instead of
+// going straight in:
+//
+//	a writeback to a block that is already here coalesces with it, and
+//	the LLC never sees it
+//	a demand access that misses in the LLC looks here next. if its
+//	block is here it goes up to the core as it would from the LLC, but
+//	the entry stays, marked forwarded, so that when the block comes
+//	back down it coalesces. until then the block is up in a core, not
+//	here, and another access to it misses
+//	a writeback that finds the buffer full drains one entry into the
+//	LLC: the oldest (DAN_WRITEBUF_DRAIN=fifo, the default) or the least
+//	recently written (lru). a forwarded block's only copy is up in a
+//	core, so draining it just drops it
+//
+// DAN_WRITEBUF_ENTRIES sets the size (0, no buffer, by default). the tags
+// are a tag_array (tagarray.h).
+
+#include <stdio.h>
+#include "tagarray.h"
+
+#define WRITEBUF_MAX_ENTRIES	256
+
+#define WRITEBUF_FIFO	0
+#define WRITEBUF_LRU	1
+
+struct writebuf_stats {
+	unsigned long long int writes;		// writebacks from the L2s
+	unsigned long long int coalesced;	// of those, the ones to a block already here
+	unsigned long long int lookups, hits;	// demand and prefetch accesses that missed in the LLC
+	unsigned long long int drains;		// entries written into the LLC
+	unsigned long long int dropped;		// forwarded entries drained without a write
+};
+
+// a writeback leaving the buffer for the LLC
+struct writebuf_entry {
+	unsigned long long int block, pc;
+	unsigned int core;
+};
+
+class write_buffer {
+	tag_array tags;
+	unsigned long long int *stamps;	// when each went in, or with lru was last written
+	unsigned long long int *pcs;	// of the last writeback to each
+	unsigned int *cores;
+	unsigned char *forwarded;
+	int policy;
+	unsigned long long int clock;
+	arena *mem;		// where the entries live
+	bool owns_mem;		// mem is the buffer's own, deleted with it
+
+public:
+	writebuf_stats stats;
+
+	// the entries come from mem, or with none from an arena of its own
+	write_buffer (int entries, int policy, arena *mem = NULL);
+	~write_buffer (void);
+
+	// is the block here? no side effects
+	bool contains (unsigned long long int block) { return tags.find (block) >= 0; }
+
+	// an access that missed in the LLC looking for the block; returns true
+	// if it is here and not already forwarded, and marks it forwarded
+	bool forward (unsigned long long int block);
+
+	// an L2 victim arrives. returns true if an entry has to go into the
+	// LLC to make room for it, and puts that in *out
+	bool write (unsigned long long int block, unsigned long long int pc, unsigned int core, writebuf_entry *out);
+
+	void report (FILE *f, const writebuf_stats *since);
+};
+
+#endif